@@ -0,0 +1,318 @@
+//
+//  coro_bench.cpp
+//
+//  对比协程和每请求一个线程两种方式维持大量同时进行的上游请求时的吞吐量、延迟、CPU时间和线程数
+//  子进程为模拟上游，每个响应延迟固定毫秒数后返回一页设备数据；父进程绑定到同一个CPU，
+//  两种方式在相同CPU下各完成相同数量的请求并解析响应：
+//  协程方式与事件循环模式相同，单线程上AsyncHttp加执行器，每个并发一个协程；
+//  线程方式每个并发一个线程，各自使用保持连接的httplib客户端阻塞请求
+//
+//  编译: g++ -O2 -std=c++20 -pthread bench/coro_bench.cpp -o coro_bench -lssl -lcrypto
+//  运行: ./coro_bench [并发数列表] [每轮请求数] [响应延迟毫秒] [每页设备数]
+//  例如: ./coro_bench 10,100,500 3000 50 1
+//
+
+// 模拟上游需要同时保持所有并发连接
+#define CPPHTTPLIB_THREAD_POOL_COUNT 1024
+#define CPPHTTPLIB_LISTEN_BACKLOG 1024
+#include "../include/httplib.h"
+#include "../include/async_http.h"
+#include "../include/coro.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <sched.h>
+#include <sstream>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using json = nlohmann::json;
+
+static int64_t nowUs()
+{
+  return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static int64_t cpuUs()
+{
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return (int64_t)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000 + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+// 进程当前线程数
+static int threadCount()
+{
+  FILE *file = fopen("/proc/self/status", "r");
+  char line[256];
+  int threads = 0;
+  while (file != nullptr && fgets(line, sizeof(line), file))
+  {
+    if (sscanf(line, "Threads: %d", &threads) == 1)
+    {
+      break;
+    }
+  }
+  if (file != nullptr)
+  {
+    fclose(file);
+  }
+  return threads;
+}
+
+// 与fleet_sim格式相同的一页设备数据
+static string makePage(int devices)
+{
+  json dataList = json::array();
+  for (int d = 0; d < devices; d++)
+  {
+    json sensorsList = json::array();
+    for (int s = 0; s < 10; s++)
+    {
+      sensorsList.push_back({{"id", 5000000 + (d * 10 + s) * 3}, {"sensorName", "压力"}, {"isLine", 1}, {"sensorTypeId", 1},
+                             {"updateDate", "2024-08-12 10:00:00"}, {"decimalPlacse", "2"}, {"value", "12.25"}});
+    }
+    dataList.push_back({{"id", 100000 + d * 7}, {"deviceName", "4G压力表"}, {"deviceNo", "SIM" + to_string(d)}, {"sensorsList", sensorsList}});
+  }
+  return json({{"flag", "00"}, {"msg", ""}, {"rowCount", devices}, {"dataList", dataList}}).dump();
+}
+
+// 模拟上游，在子进程中运行
+static void serve(int port, int delayMs, const string &page)
+{
+  httplib::Server server;
+  server.set_tcp_nodelay(true);
+  server.set_keep_alive_max_count(1000000);
+  server.Post("/api/device/getDeviceSensorDatas", [&](const httplib::Request &, httplib::Response &res)
+  {
+    this_thread::sleep_for(chrono::milliseconds(delayMs));
+    res.set_content(page, "application/json");
+  });
+  server.listen("127.0.0.1", port);
+}
+
+struct Result
+{
+  vector<int64_t> latencies;
+  int64_t wallUs = 0;
+  int64_t cpuUs = 0;
+  int threads = 0;
+  size_t failed = 0;
+};
+
+static size_t parseSensors(const string &body)
+{
+  json data = json::parse(body, nullptr, false);
+  size_t sensors = 0;
+  if (!data.is_discarded() && data["dataList"].is_array())
+  {
+    for (auto &device : data["dataList"])
+    {
+      sensors += device["sensorsList"].size();
+    }
+  }
+  return sensors;
+}
+
+// 协程方式，每个并发一个协程在同一个线程上交替等待
+struct CoroRun
+{
+  AsyncHttp http;
+  Executor executor;
+  Result result;
+  int remaining = 0;
+  int running = 0;
+
+  struct Call
+  {
+    CoroRun &run;
+    AsyncHttp::Response response;
+
+    bool await_ready() const
+    {
+      return false;
+    }
+
+    void await_suspend(coroutine_handle<> handle)
+    {
+      run.http.request("POST", "/api/device/getDeviceSensorDatas", {{"Content-Type", "application/json"}}, "{}",
+                       [this, handle](const AsyncHttp::Response &res)
+                       {
+                         response = res;
+                         run.executor.post(handle);
+                       });
+    }
+
+    AsyncHttp::Response await_resume()
+    {
+      return move(response);
+    }
+  };
+
+  Task<void> worker()
+  {
+    while (remaining > 0)
+    {
+      remaining--;
+      int64_t start = nowUs();
+      Call call = {*this, {}};
+      AsyncHttp::Response res = co_await call;
+      if (parseSensors(res.body) == 0)
+      {
+        result.failed++;
+      }
+      result.latencies.push_back(nowUs() - start);
+    }
+    running--;
+  }
+};
+
+static Result runCoroutines(const string &url, int concurrency, int requests)
+{
+  int ep = epoll_create1(EPOLL_CLOEXEC);
+  CoroRun run;
+  run.http.init(ep, url, 60000, concurrency);
+  run.remaining = requests;
+  run.running = concurrency;
+  int64_t start = nowUs();
+  int64_t cpuStart = cpuUs();
+  for (int i = 0; i < concurrency; i++)
+  {
+    run.executor.spawn(run.worker());
+  }
+  run.executor.run();
+  run.result.threads = threadCount();
+  epoll_event events[256];
+  while (run.running > 0)
+  {
+    int timeout = run.executor.empty() ? run.http.expire() : 0;
+    int count = epoll_wait(ep, events, 256, timeout);
+    for (int i = 0; i < count; i++)
+    {
+      run.http.handle(events[i].data.u64, events[i].events);
+    }
+    run.executor.run();
+  }
+  run.result.wallUs = nowUs() - start;
+  run.result.cpuUs = cpuUs() - cpuStart;
+  close(ep);
+  return move(run.result);
+}
+
+// 每请求一个线程，各线程使用保持连接的阻塞客户端
+static Result runThreads(const string &url, int concurrency, int requests)
+{
+  Result result;
+  atomic<int> remaining{requests};
+  atomic<size_t> failed{0};
+  vector<vector<int64_t>> latencies(concurrency);
+  atomic<int> peak{0};
+  int64_t start = nowUs();
+  int64_t cpuStart = cpuUs();
+  vector<thread> threads;
+  for (int i = 0; i < concurrency; i++)
+  {
+    threads.emplace_back([&, i]()
+    {
+      httplib::Client cli(url);
+      cli.set_keep_alive(true);
+      cli.set_read_timeout(60, 0);
+      while (remaining.fetch_sub(1) > 0)
+      {
+        int64_t begin = nowUs();
+        auto res = cli.Post("/api/device/getDeviceSensorDatas", "{}", "application/json");
+        if (!res || parseSensors(res->body) == 0)
+        {
+          failed++;
+        }
+        latencies[i].push_back(nowUs() - begin);
+        if (i == 0)
+        {
+          peak = max(peak.load(), threadCount());
+        }
+      }
+    });
+  }
+  for (thread &t : threads)
+  {
+    t.join();
+  }
+  result.wallUs = nowUs() - start;
+  result.cpuUs = cpuUs() - cpuStart;
+  result.threads = peak;
+  result.failed = failed;
+  for (auto &items : latencies)
+  {
+    result.latencies.insert(result.latencies.end(), items.begin(), items.end());
+  }
+  return result;
+}
+
+static void report(const char *name, int concurrency, Result &result)
+{
+  sort(result.latencies.begin(), result.latencies.end());
+  auto quantile = [&result](double q)
+  {
+    return result.latencies.empty() ? 0 : result.latencies[min(result.latencies.size() - 1, (size_t)(result.latencies.size() * q))];
+  };
+  size_t count = result.latencies.size();
+  printf("%-8s %8d %10.0f %10.1f %10.1f %10lld %10.1f %8d %7zu\n", name, concurrency, count / (result.wallUs / 1e6),
+         quantile(0.5) / 1000.0, quantile(0.99) / 1000.0, (long long)(result.cpuUs / 1000),
+         count ? (double)result.cpuUs / count : 0.0, result.threads, result.failed);
+  fflush(stdout);
+}
+
+int main(int argc, char *argv[])
+{
+  string list = argc > 1 ? argv[1] : "10,100,500";
+  int requests = argc > 2 ? atoi(argv[2]) : 5000;
+  int delayMs = argc > 3 ? atoi(argv[3]) : 50;
+  int devices = argc > 4 ? atoi(argv[4]) : 10;
+  int port = 18090;
+  string url = "http://127.0.0.1:" + to_string(port);
+
+  pid_t child = fork();
+  if (child == 0)
+  {
+    serve(port, delayMs, makePage(devices));
+    _exit(0);
+  }
+  // 父进程绑定到一个CPU，两种方式使用相同的CPU
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(0, &cpus);
+  sched_setaffinity(0, sizeof(cpus), &cpus);
+  httplib::Client probe(url);
+  for (int i = 0; i < 100 && !probe.Post("/api/device/getDeviceSensorDatas", "{}", "application/json"); i++)
+  {
+    this_thread::sleep_for(chrono::milliseconds(50));
+  }
+
+  printf("requests=%d delay=%dms page_bytes=%zu\n", requests, delayMs, makePage(devices).size());
+  printf("%-8s %8s %10s %10s %10s %10s %10s %8s %7s\n", "mode", "inflight", "req_per_s", "p50_ms", "p99_ms", "cpu_ms",
+         "cpu_us_req", "threads", "failed");
+  stringstream ss(list);
+  string item;
+  while (getline(ss, item, ','))
+  {
+    int concurrency = atoi(item.c_str());
+    if (concurrency <= 0)
+    {
+      continue;
+    }
+    Result coro = runCoroutines(url, concurrency, requests);
+    report("coro", concurrency, coro);
+    Result threads = runThreads(url, concurrency, requests);
+    report("thread", concurrency, threads);
+  }
+  kill(child, SIGTERM);
+  waitpid(child, nullptr, 0);
+  return 0;
+}
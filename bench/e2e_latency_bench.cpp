@@ -0,0 +1,417 @@
+//
+//  e2e_latency_bench.cpp
+//
+//  从上游数据变化到OPC-UA订阅者收到通知的端到端延迟
+//  本进程同时是模拟的设备接口服务和订阅客户端，服务端在两者之间：
+//  模拟接口与fleet_sim的格式相同，按指定速率随机挑选被订阅的传感器注入变化，每次变化的数值为
+//  递增的序号、updateDate前进1秒，记录变化对接口可见的时刻；客户端订阅前N个传感器，
+//  收到DataChange通知时按数值找到对应的注入时刻，两个时刻取自同一个单调时钟，无需对时
+//  两次拉取之间同一传感器的多次变化只有最后一次可见，较早的记为被覆盖；
+//  注入结束后继续等待未送达的变化，超时仍未送达的记为丢失
+//
+//  编译: g++ -O2 -std=c++17 -pthread bench/e2e_latency_bench.cpp -o e2e_latency_bench -lopen62541
+//  运行: ./e2e_latency_bench [接口端口] [服务地址] [设备数] [每设备传感器数] [订阅数] [每秒变化数] [秒数]
+//        [发布间隔毫秒] [采样间隔毫秒] [等待秒数]
+//  例如: ./e2e_latency_bench 18080 opc.tcp://127.0.0.1:4840 1000 10 1000 200 60 50 0 15
+//  启动后再启动服务端，config.json中设置"apiUrl": "http://127.0.0.1:18080"，关闭lazyNodes，
+//  服务端创建全部传感器变量后开始订阅和注入
+//
+
+#include "../include/httplib.h"
+#include <nlohmann/json.hpp>
+#include <open62541/client.h>
+#include <open62541/client_config_default.h>
+#include <open62541/client_highlevel.h>
+#include <open62541/client_subscriptions.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace httplib;
+using json = nlohmann::json;
+
+static int64_t nowUs()
+{
+  return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// 传感器ID与fleet_sim的生成规则一致
+static int sensorIdOf(size_t index)
+{
+  return 5000000 + (int)index * 3;
+}
+
+// Upstream结构体，模拟接口的传感器状态和注入记录，全部由lock保护
+struct Upstream
+{
+  int sensorsPerDevice;
+  size_t deviceCount;
+  // 每个传感器的版本和当前数值（最近一次注入的序号，0为初始值）
+  vector<uint32_t> versions;
+  vector<uint32_t> values;
+  // 每个传感器尚未送达的序号
+  vector<uint32_t> pending;
+  // 每个序号的注入时刻，下标为序号
+  vector<int64_t> injectedAt;
+  size_t superseded = 0;
+  size_t outstanding = 0;
+  mutex lock;
+
+  // 生成一页设备数据，全部为整数型传感器
+  string page(int currPage, int pageSize)
+  {
+    json dataList = json::array();
+    size_t begin = (size_t)(currPage - 1) * pageSize;
+    for (size_t d = begin; d < deviceCount && d < begin + pageSize; d++)
+    {
+      json sensorsList = json::array();
+      for (int i = 0; i < sensorsPerDevice; i++)
+      {
+        size_t index = d * sensorsPerDevice + i;
+        sensorsList.push_back({
+            {"id", sensorIdOf(index)},
+            {"sensorName", "压力"},
+            {"isLine", 1},
+            {"sensorTypeId", 1},
+            {"decimalPlacse", "0"},
+            {"value", to_string(values[index])},
+            {"updateDate", formatDate(versions[index])},
+        });
+      }
+      dataList.push_back({
+          {"id", 100000 + (int)d * 7},
+          {"deviceName", "4G压力表"},
+          {"deviceNo", "SIM" + to_string(100000 + d * 7)},
+          {"sensorsList", sensorsList},
+      });
+    }
+    return json({{"flag", "00"}, {"msg", ""}, {"rowCount", deviceCount}, {"dataList", dataList}}).dump();
+  }
+
+  // 每个版本前进1秒，同一传感器的每次变化都有不同的updateDate
+  static string formatDate(uint32_t version)
+  {
+    time_t ts = 1723420800 + (time_t)version;
+    struct tm tm;
+    gmtime_r(&ts, &tm);
+    char buf[32];
+    strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
+    return buf;
+  }
+
+  // 注入一次变化，未送达的前一次变化记为被覆盖
+  void inject(size_t index)
+  {
+    lock_guard<mutex> guard(lock);
+    uint32_t seq = (uint32_t)injectedAt.size();
+    if (pending[index] != 0)
+    {
+      superseded++;
+      outstanding--;
+    }
+    versions[index]++;
+    values[index] = seq;
+    pending[index] = seq;
+    outstanding++;
+    injectedAt.push_back(nowUs());
+  }
+};
+
+// Subscriber结构体，订阅者收到的通知
+struct Subscriber
+{
+  Upstream *upstream;
+  vector<int64_t> latencies;
+  size_t notifications = 0;
+  size_t stale = 0;
+};
+
+static Subscriber subscriber;
+
+// 读取整数型通知的数值，传感器变量为IntegerId，也兼容其它整数类型
+static bool notifiedValue(const UA_DataValue *value, uint32_t &result)
+{
+  if (!value->hasValue || !UA_Variant_isScalar(&value->value))
+  {
+    return false;
+  }
+  const UA_DataType *type = value->value.type;
+  if (type == &UA_TYPES[UA_TYPES_UINT32])
+  {
+    result = *(UA_UInt32 *)value->value.data;
+  }
+  else if (type == &UA_TYPES[UA_TYPES_INT32])
+  {
+    result = (uint32_t) * (UA_Int32 *)value->value.data;
+  }
+  else if (type == &UA_TYPES[UA_TYPES_INT64])
+  {
+    result = (uint32_t) * (UA_Int64 *)value->value.data;
+  }
+  else if (type == &UA_TYPES[UA_TYPES_UINT64])
+  {
+    result = (uint32_t) * (UA_UInt64 *)value->value.data;
+  }
+  else
+  {
+    return false;
+  }
+  return true;
+}
+
+// 数据变化通知，monContext为传感器下标
+static void dataChanged(UA_Client *, UA_UInt32, void *, UA_UInt32, void *monContext, UA_DataValue *value)
+{
+  int64_t now = nowUs();
+  size_t index = (size_t)(uintptr_t)monContext;
+  uint32_t seq;
+  subscriber.notifications++;
+  if (!notifiedValue(value, seq) || seq == 0)
+  {
+    return;
+  }
+  Upstream &upstream = *subscriber.upstream;
+  lock_guard<mutex> guard(upstream.lock);
+  if (upstream.pending[index] != seq)
+  {
+    subscriber.stale++;
+    return;
+  }
+  upstream.pending[index] = 0;
+  upstream.outstanding--;
+  subscriber.latencies.push_back(now - upstream.injectedAt[seq]);
+}
+
+int main(int argc, char *argv[])
+{
+  int port = argc > 1 ? atoi(argv[1]) : 18080;
+  const char *endpoint = argc > 2 ? argv[2] : "opc.tcp://127.0.0.1:4840";
+  size_t deviceCount = argc > 3 ? max(atoi(argv[3]), 1) : 1000;
+  int sensorsPerDevice = argc > 4 ? max(atoi(argv[4]), 1) : 10;
+  size_t monitored = argc > 5 ? atoi(argv[5]) : 1000;
+  double rate = argc > 6 ? atof(argv[6]) : 200;
+  double duration = argc > 7 ? atof(argv[7]) : 60;
+  double publishMs = argc > 8 ? atof(argv[8]) : 50;
+  double samplingMs = argc > 9 ? atof(argv[9]) : 0;
+  double drainSec = argc > 10 ? atof(argv[10]) : 15;
+
+  Upstream upstream;
+  upstream.sensorsPerDevice = sensorsPerDevice;
+  upstream.deviceCount = deviceCount;
+  size_t sensorCount = deviceCount * sensorsPerDevice;
+  monitored = max<size_t>(min(monitored, sensorCount), 1);
+  upstream.versions.assign(sensorCount, 0);
+  upstream.values.assign(sensorCount, 0);
+  upstream.pending.assign(sensorCount, 0);
+  // 序号0保留为初始值
+  upstream.injectedAt.push_back(0);
+  subscriber.upstream = &upstream;
+
+  // 模拟接口，使用固定token
+  Server server;
+  size_t cycles = 0;
+  server.Post("/oauth/token", [](const Request &, Response &res)
+  {
+    json data = {{"token_type", "bearer"}, {"expires_in", 7200}, {"userId", 1}, {"access_token", "e2e-token"}};
+    res.set_content(data.dump(), "application/json");
+  });
+  server.Post("/api/device/getDeviceSensorDatas", [&](const Request &req, Response &res)
+  {
+    json body = json::parse(req.body, nullptr, false);
+    if (body.is_discarded() || !body["currPage"].is_number() || !body["pageSize"].is_number())
+    {
+      res.set_content("{\"flag\":\"01\",\"msg\":\"参数错误\"}", "application/json");
+      return;
+    }
+    int currPage = body["currPage"];
+    int pageSize = body["pageSize"];
+    lock_guard<mutex> guard(upstream.lock);
+    if (currPage == 1)
+    {
+      printf("cycle=%zu injected=%zu outstanding=%zu\n", ++cycles, upstream.injectedAt.size() - 1,
+             upstream.outstanding);
+      fflush(stdout);
+    }
+    res.set_content(upstream.page(currPage, pageSize > 0 ? pageSize : 100), "application/json");
+  });
+  thread serverThread([&server, port]
+                      { server.listen("127.0.0.1", port); });
+
+  printf("upstream port=%d devices=%zu sensors=%zu monitored=%zu rate=%.0f/s duration=%.0fs publish=%.0fms "
+         "sampling=%.0fms\n",
+         port, deviceCount, sensorCount, monitored, rate, duration, publishMs, samplingMs);
+  fflush(stdout);
+
+  // 等待服务端启动并创建最后一个被订阅的传感器变量
+  UA_Client *client = UA_Client_new();
+  UA_ClientConfig_setDefault(UA_Client_getConfig(client));
+  UA_UInt16 sensorNsIndex = 0;
+  UA_String nsUri = UA_STRING((char *)"sensor");
+  auto waitUntil = chrono::steady_clock::now() + chrono::seconds(120);
+  bool ready = false;
+  while (!ready && chrono::steady_clock::now() < waitUntil)
+  {
+    if (UA_Client_connect(client, endpoint) == UA_STATUSCODE_GOOD &&
+        UA_Client_NamespaceGetIndex(client, &nsUri, &sensorNsIndex) == UA_STATUSCODE_GOOD)
+    {
+      UA_Variant value;
+      UA_Variant_init(&value);
+      ready = UA_Client_readValueAttribute(client, UA_NODEID_NUMERIC(sensorNsIndex, sensorIdOf(monitored - 1)),
+                                           &value) == UA_STATUSCODE_GOOD;
+      UA_Variant_clear(&value);
+    }
+    if (!ready)
+    {
+      this_thread::sleep_for(chrono::seconds(1));
+    }
+  }
+  if (!ready)
+  {
+    printf("sensor variables not available: %s\n", endpoint);
+    UA_Client_delete(client);
+    server.stop();
+    serverThread.join();
+    return 1;
+  }
+
+  // 订阅前N个传感器，分批创建监视项
+  UA_CreateSubscriptionRequest subRequest = UA_CreateSubscriptionRequest_default();
+  subRequest.requestedPublishingInterval = publishMs;
+  UA_CreateSubscriptionResponse subResponse = UA_Client_Subscriptions_create(client, subRequest, NULL, NULL, NULL);
+  if (subResponse.responseHeader.serviceResult != UA_STATUSCODE_GOOD)
+  {
+    printf("create subscription failed: %s\n", UA_StatusCode_name(subResponse.responseHeader.serviceResult));
+    UA_Client_delete(client);
+    server.stop();
+    serverThread.join();
+    return 1;
+  }
+  UA_UInt32 subId = subResponse.subscriptionId;
+  size_t failed = 0;
+  const size_t batch = 1000;
+  for (size_t first = 0; first < monitored; first += batch)
+  {
+    size_t count = min(batch, monitored - first);
+    vector<UA_MonitoredItemCreateRequest> items(count);
+    vector<void *> contexts(count);
+    vector<UA_Client_DataChangeNotificationCallback> callbacks(count, dataChanged);
+    vector<UA_Client_DeleteMonitoredItemCallback> deleteCallbacks(count, nullptr);
+    for (size_t i = 0; i < count; i++)
+    {
+      items[i] = UA_MonitoredItemCreateRequest_default(UA_NODEID_NUMERIC(sensorNsIndex, sensorIdOf(first + i)));
+      items[i].requestedParameters.samplingInterval = samplingMs;
+      items[i].requestedParameters.queueSize = 10;
+      contexts[i] = (void *)(uintptr_t)(first + i);
+    }
+    UA_CreateMonitoredItemsRequest request;
+    UA_CreateMonitoredItemsRequest_init(&request);
+    request.subscriptionId = subId;
+    request.timestampsToReturn = UA_TIMESTAMPSTORETURN_BOTH;
+    request.itemsToCreate = items.data();
+    request.itemsToCreateSize = count;
+    UA_CreateMonitoredItemsResponse response = UA_Client_MonitoredItems_createDataChanges(
+        client, request, contexts.data(), callbacks.data(), deleteCallbacks.data());
+    for (size_t i = 0; i < response.resultsSize; i++)
+    {
+      failed += response.results[i].statusCode != UA_STATUSCODE_GOOD;
+    }
+    failed += count - response.resultsSize;
+    UA_CreateMonitoredItemsResponse_clear(&response);
+  }
+  if (failed > 0)
+  {
+    printf("create monitored items failed: %zu/%zu\n", failed, monitored);
+    UA_Client_disconnect(client);
+    UA_Client_delete(client);
+    server.stop();
+    serverThread.join();
+    return 1;
+  }
+
+  // 处理创建监视项时的初始通知后开始注入
+  auto settle = chrono::steady_clock::now() + chrono::seconds(1);
+  while (chrono::steady_clock::now() < settle)
+  {
+    UA_Client_run_iterate(client, 10);
+  }
+  atomic<bool> injecting{true};
+  thread injector([&]
+                  {
+    mt19937 rng(42);
+    uniform_int_distribution<size_t> pick(0, monitored - 1);
+    auto next = chrono::steady_clock::now();
+    auto step = chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(1.0 / max(rate, 0.001)));
+    while (injecting)
+    {
+      upstream.inject(pick(rng));
+      next += step;
+      this_thread::sleep_until(next);
+    } });
+
+  // 注入期间和之后的等待期间处理通知，全部送达后提前结束等待
+  auto begin = chrono::steady_clock::now();
+  auto injectEnd = begin + chrono::duration<double>(duration);
+  auto drainEnd = injectEnd + chrono::duration<double>(drainSec);
+  for (;;)
+  {
+    UA_StatusCode retval = UA_Client_run_iterate(client, 5);
+    if (retval != UA_STATUSCODE_GOOD)
+    {
+      printf("client error: %s\n", UA_StatusCode_name(retval));
+      break;
+    }
+    auto now = chrono::steady_clock::now();
+    if (injecting && now >= injectEnd)
+    {
+      injecting = false;
+      injector.join();
+    }
+    if (!injecting)
+    {
+      lock_guard<mutex> guard(upstream.lock);
+      if (upstream.outstanding == 0 || now >= drainEnd)
+      {
+        break;
+      }
+    }
+  }
+  if (injecting)
+  {
+    injecting = false;
+    injector.join();
+  }
+  double elapsed = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+  UA_Client_disconnect(client);
+  UA_Client_delete(client);
+  server.stop();
+  serverThread.join();
+
+  vector<int64_t> &latencies = subscriber.latencies;
+  size_t injected = upstream.injectedAt.size() - 1;
+  printf("injected=%zu delivered=%zu superseded=%zu lost=%zu stale=%zu notifications=%zu\n", injected,
+         latencies.size(), upstream.superseded, upstream.outstanding, subscriber.stale, subscriber.notifications);
+  if (latencies.empty())
+  {
+    printf("no changes delivered\n");
+    return 1;
+  }
+  sort(latencies.begin(), latencies.end());
+  auto quantile = [&latencies](double q)
+  {
+    return latencies[min(latencies.size() - 1, (size_t)(latencies.size() * q))] / 1000.0;
+  };
+  printf("throughput injected=%.1f/s delivered=%.1f/s elapsed=%.1fs\n", injected / duration, latencies.size() / elapsed,
+         elapsed);
+  printf("latency_ms p50=%.1f p99=%.1f p999=%.1f max=%.1f\n", quantile(0.5), quantile(0.99), quantile(0.999),
+         latencies.back() / 1000.0);
+  return 0;
+}
@@ -0,0 +1,371 @@
+//
+//  fleet_sim.cpp
+//
+//  本地模拟的设备接口服务，生成指定规模的合成设备和传感器，实现/oauth/token和
+//  /api/device/getDeviceSensorDatas分页接口，用于在本机以1k到1M个传感器压测服务端
+//
+//  每次请求第1页开始一个新周期，按变化比例随机挑选传感器更新数值和时间，
+//  离线比例的传感器固定返回isLine为0，传感器类型按配比在1/2/4/5/6/8中分配；
+//  响应延迟模拟慢速上游，每个设备页和token请求延迟指定毫秒数后返回，用于测量停止时中断请求的耗时；
+//  token有效秒数大于0时每次请求token签发新token和一次性的refresh token，token在声明有效期的90%后
+//  即被拒绝（返回401），用于验证服务端的提前刷新、被拒绝后重试和refresh token授权，为0时使用固定token；
+//  故障比例的请求随机返回503，故障窗口"起始秒:持续秒"内全部请求返回503，用于验证服务端的重试和熔断
+//
+//  编译: g++ -O2 -std=c++17 -pthread bench/fleet_sim.cpp -o fleet_sim
+//  运行: ./fleet_sim [设备数] [每设备传感器数] [变化比例] [离线比例] [端口] [类型配比] [响应延迟毫秒] [token有效秒数] [故障比例] [故障窗口]
+//  例如: ./fleet_sim 10000 10 0.1 0.05 18080 1:40,2:20,4:10,5:10,6:10,8:10
+//  服务端config.json中设置"apiUrl": "http://127.0.0.1:18080"，日志中的
+//  "拉取周期"一行记录每个周期的耗时、CPU时间和常驻内存
+//
+
+#include "../include/httplib.h"
+#include <nlohmann/json.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace httplib;
+using json = nlohmann::json;
+
+// 模拟的token
+static const char *TOKEN = "fleet-sim-token";
+
+// 合成传感器
+struct SimSensor
+{
+  int sensorId;
+  uint8_t typeId;
+  uint8_t decimals;
+  bool offline;
+  // 最近一次变化的周期
+  uint32_t version;
+};
+
+struct SimDevice
+{
+  int deviceId;
+  uint32_t firstSensor;
+};
+
+struct Fleet
+{
+  vector<SimDevice> devices;
+  vector<SimSensor> sensors;
+  int sensorsPerDevice;
+  double changeRate;
+  uint32_t cycle = 0;
+  mt19937 rng{42};
+  mutex lock;
+
+  // 开始新周期，按变化比例更新传感器
+  void nextCycle()
+  {
+    cycle++;
+    bernoulli_distribution change(changeRate);
+    for (SimSensor &sensor : sensors)
+    {
+      if (cycle == 1 || change(rng))
+      {
+        sensor.version = cycle;
+      }
+    }
+  }
+
+  // 生成一页设备数据
+  string page(int currPage, int pageSize)
+  {
+    json dataList = json::array();
+    size_t begin = (size_t)(currPage - 1) * pageSize;
+    for (size_t d = begin; d < devices.size() && d < begin + pageSize; d++)
+    {
+      const SimDevice &device = devices[d];
+      json sensorsList = json::array();
+      for (int i = 0; i < sensorsPerDevice; i++)
+      {
+        const SimSensor &sensor = sensors[device.firstSensor + i];
+        json item = {
+            {"id", sensor.sensorId},
+            {"sensorName", sensor.typeId == 2 || sensor.typeId == 5 ? "开关" : "压力"},
+            {"isLine", sensor.offline ? 0 : 1},
+            {"sensorTypeId", sensor.typeId},
+            {"updateDate", formatDate(sensor.version)},
+        };
+        if (sensor.typeId == 1)
+        {
+          item["decimalPlacse"] = to_string(sensor.decimals);
+          double value = (sensor.sensorId % 1000) + sensor.version * 0.25;
+          char buf[32];
+          snprintf(buf, sizeof(buf), "%.*f", (int)sensor.decimals, value);
+          item["value"] = buf;
+        }
+        else if (sensor.typeId == 2 || sensor.typeId == 5)
+        {
+          item["switcher"] = (int)(sensor.version & 1);
+        }
+        else
+        {
+          item["value"] = "状态" + to_string(sensor.version % 7);
+        }
+        sensorsList.push_back(item);
+      }
+      dataList.push_back({
+          {"id", device.deviceId},
+          {"deviceName", "4G压力表"},
+          {"deviceNo", "SIM" + to_string(device.deviceId)},
+          {"sensorsList", sensorsList},
+      });
+    }
+    json data = {
+        {"flag", "00"},
+        {"msg", ""},
+        {"rowCount", devices.size()},
+        {"dataList", dataList},
+    };
+    return data.dump();
+  }
+
+  // 传感器在某周期的更新时间，每周期前进10秒
+  static string formatDate(uint32_t version)
+  {
+    time_t ts = 1723420800 + (time_t)version * 10;
+    struct tm tm;
+    gmtime_r(&ts, &tm);
+    char buf[32];
+    strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
+    return buf;
+  }
+};
+
+// 解析类型配比，如"1:40,2:20"
+static vector<pair<int, double>> parseMix(const string &mix)
+{
+  vector<pair<int, double>> weights;
+  stringstream ss(mix);
+  string item;
+  while (getline(ss, item, ','))
+  {
+    size_t colon = item.find(':');
+    int typeId = atoi(item.substr(0, colon).c_str());
+    double weight = colon == string::npos ? 1 : atof(item.substr(colon + 1).c_str());
+    if (typeId == 1 || typeId == 2 || typeId == 4 || typeId == 5 || typeId == 6 || typeId == 8)
+    {
+      weights.emplace_back(typeId, weight);
+    }
+  }
+  return weights;
+}
+
+int main(int argc, char *argv[])
+{
+  int deviceCount = argc > 1 ? atoi(argv[1]) : 1000;
+  int sensorsPerDevice = argc > 2 ? atoi(argv[2]) : 10;
+  double changeRate = argc > 3 ? atof(argv[3]) : 0.1;
+  double offlineRate = argc > 4 ? atof(argv[4]) : 0.05;
+  int port = argc > 5 ? atoi(argv[5]) : 18080;
+  vector<pair<int, double>> mix = parseMix(argc > 6 ? argv[6] : "1:40,2:20,4:10,5:10,6:10,8:10");
+  int delayMs = argc > 7 ? atoi(argv[7]) : 0;
+  int tokenSec = argc > 8 ? atoi(argv[8]) : 0;
+  double failRate = argc > 9 ? atof(argv[9]) : 0;
+  double outageStart = 0;
+  double outageSec = 0;
+  if (argc > 10 && sscanf(argv[10], "%lf:%lf", &outageStart, &outageSec) != 2)
+  {
+    printf("invalid outage window\n");
+    return 1;
+  }
+  if (mix.empty())
+  {
+    printf("invalid type mix\n");
+    return 1;
+  }
+
+  // 生成设备和传感器，ID与真实数据一样稀疏
+  Fleet fleet;
+  fleet.sensorsPerDevice = sensorsPerDevice;
+  fleet.changeRate = changeRate;
+  vector<double> weights;
+  for (auto &item : mix)
+  {
+    weights.push_back(item.second);
+  }
+  discrete_distribution<int> pickType(weights.begin(), weights.end());
+  bernoulli_distribution offline(offlineRate);
+  fleet.devices.reserve(deviceCount);
+  fleet.sensors.reserve((size_t)deviceCount * sensorsPerDevice);
+  for (int d = 0; d < deviceCount; d++)
+  {
+    fleet.devices.push_back(SimDevice{100000 + d * 7, (uint32_t)fleet.sensors.size()});
+    for (int s = 0; s < sensorsPerDevice; s++)
+    {
+      SimSensor sensor = {};
+      sensor.sensorId = 5000000 + (d * sensorsPerDevice + s) * 3;
+      sensor.typeId = (uint8_t)mix[pickType(fleet.rng)].first;
+      sensor.decimals = (uint8_t)(sensor.sensorId % 3);
+      sensor.offline = offline(fleet.rng);
+      fleet.sensors.push_back(sensor);
+    }
+  }
+
+  Server server;
+  atomic<size_t> requests{0};
+  atomic<size_t> bytes{0};
+  chrono::steady_clock::time_point cycleStart = chrono::steady_clock::now();
+
+  // 签发的token和实际失效时间
+  mutex tokenLock;
+  map<string, chrono::steady_clock::time_point> tokens;
+  set<string> refreshTokens;
+  size_t tokenCount = 0;
+  size_t passwordGrants = 0;
+  size_t refreshGrants = 0;
+  size_t rejected = 0;
+
+  // 注入的故障，按比例随机失败，故障窗口内全部失败
+  chrono::steady_clock::time_point launched = chrono::steady_clock::now();
+  mutex failLock;
+  mt19937 failRng(11);
+  bernoulli_distribution failPick(failRate);
+  atomic<size_t> failed{0};
+  auto inject = [&](Response &res)
+  {
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - launched).count();
+    bool fail = outageSec > 0 && elapsed >= outageStart && elapsed < outageStart + outageSec;
+    if (!fail && failRate > 0)
+    {
+      lock_guard<mutex> guard(failLock);
+      fail = failPick(failRng);
+    }
+    if (fail)
+    {
+      failed++;
+      res.status = 503;
+      res.set_content("{\"error\":\"unavailable\"}", "application/json");
+    }
+    return fail;
+  };
+
+  server.Post("/oauth/token", [&](const Request &req, Response &res)
+  {
+    if (delayMs > 0)
+    {
+      this_thread::sleep_for(chrono::milliseconds(delayMs));
+    }
+    if (inject(res))
+    {
+      return;
+    }
+    string token = TOKEN;
+    json data = {
+        {"token_type", "bearer"},
+        {"expires_in", tokenSec > 0 ? tokenSec : 7200},
+        {"userId", 1},
+    };
+    if (tokenSec > 0)
+    {
+      lock_guard<mutex> guard(tokenLock);
+      // refresh token只能使用一次
+      if (req.get_param_value("grant_type") == "refresh_token")
+      {
+        if (refreshTokens.erase(req.get_param_value("refresh_token")) == 0)
+        {
+          res.status = 400;
+          res.set_content("{\"error\":\"invalid_grant\"}", "application/json");
+          return;
+        }
+        refreshGrants++;
+      }
+      else
+      {
+        passwordGrants++;
+      }
+      token += "-" + to_string(++tokenCount);
+      tokens[token] = chrono::steady_clock::now() + chrono::milliseconds(tokenSec * 900);
+      string refresh = "fleet-sim-refresh-" + to_string(tokenCount);
+      refreshTokens.insert(refresh);
+      data["refresh_token"] = refresh;
+      printf("token=%zu password=%zu refresh=%zu rejected=%zu\n", tokenCount, passwordGrants, refreshGrants, rejected);
+      fflush(stdout);
+    }
+    data["access_token"] = token;
+    res.set_content(data.dump(), "application/json");
+  });
+
+  // 检查token，签发新token时按实际失效时间检查
+  auto authorized = [&](const Request &req)
+  {
+    string header = req.get_header_value("Authorization");
+    if (tokenSec <= 0)
+    {
+      return header == string("Bearer ") + TOKEN;
+    }
+    lock_guard<mutex> guard(tokenLock);
+    auto iter = header.size() > 7 ? tokens.find(header.substr(7)) : tokens.end();
+    if (iter != tokens.end() && chrono::steady_clock::now() < iter->second)
+    {
+      return true;
+    }
+    rejected++;
+    return false;
+  };
+
+  server.Post("/api/device/getDeviceSensorDatas", [&](const Request &req, Response &res)
+  {
+    if (inject(res))
+    {
+      return;
+    }
+    if (!authorized(req))
+    {
+      res.status = 401;
+      res.set_content("{\"error\":\"invalid_token\"}", "application/json");
+      return;
+    }
+    json body = json::parse(req.body, nullptr, false);
+    if (body.is_discarded() || !body["currPage"].is_number() || !body["pageSize"].is_number())
+    {
+      res.set_content("{\"flag\":\"01\",\"msg\":\"参数错误\"}", "application/json");
+      return;
+    }
+    int currPage = body["currPage"];
+    int pageSize = body["pageSize"];
+    if (delayMs > 0)
+    {
+      this_thread::sleep_for(chrono::milliseconds(delayMs));
+    }
+    lock_guard<mutex> guard(fleet.lock);
+    if (currPage == 1)
+    {
+      auto now = chrono::steady_clock::now();
+      if (fleet.cycle > 0)
+      {
+        printf("cycle=%u requests=%zu bytes=%zu interval=%.3fs failed=%zu\n", fleet.cycle, requests.load(), bytes.load(),
+               chrono::duration<double>(now - cycleStart).count(), failed.load());
+        fflush(stdout);
+      }
+      requests = 0;
+      bytes = 0;
+      cycleStart = now;
+      fleet.nextCycle();
+    }
+    string content = fleet.page(currPage, pageSize > 0 ? pageSize : 100);
+    requests++;
+    bytes += content.size();
+    res.set_content(content, "application/json");
+  });
+
+  printf("fleet devices=%d sensors=%zu change=%.3f offline=%.3f port=%d\n", deviceCount, fleet.sensors.size(),
+         changeRate, offlineRate, port);
+  fflush(stdout);
+  return server.listen("127.0.0.1", port) ? 0 : 1;
+}
@@ -0,0 +1,222 @@
+//
+//  ingest_bench.cpp
+//
+//  拉取热路径的微基准：设备页json::parse、updateDeviceData、按传感器类型的updateSensorData、
+//  updateVariable和createSensorVariable，后四项在1000、10000和100000个传感器的规模下测量
+//  通过include/ingest.h使用服务端的实际实现，进程内创建UA_Server并填充合成设备，不启动网络；
+//  合成数据与bench/fleet_sim.cpp的格式相同，更新时在两组时间和数值之间交替，每次都真正写入变量
+//
+//  使用Google Benchmark计时，保存每个版本的JSON结果后可用其tools/compare.py对比
+//
+//  编译: g++ -O2 -std=c++17 -pthread -DNDEBUG bench/ingest_bench.cpp -o ingest_bench $(pkg-config --cflags --libs benchmark) -lopen62541
+//  运行: ./ingest_bench [--benchmark_filter=正则] [--benchmark_repetitions=3] [--benchmark_out=文件]
+//  例如: ./ingest_bench --benchmark_repetitions=3 --benchmark_out=ingest.json
+//
+
+#include "../include/ingest.h"
+#include <algorithm>
+#include <open62541/server_config_default.h>
+#include <open62541/plugin/log_stdout.h>
+#include <benchmark/benchmark.h>
+
+using namespace std;
+using nlohmann::json;
+
+static const int SENSORS_PER_DEVICE = 10;
+static const int TYPE_IDS[] = {1, 2, 4, 5, 6, 8};
+static const int SIZES[] = {1000, 10000, 100000};
+
+// 与fleet_sim格式相同的一台设备，tick不同时所有传感器的时间和数值都不同
+static json makeDevice(int index, int tick)
+{
+  json sensorsList = json::array();
+  for (int s = 0; s < SENSORS_PER_DEVICE; s++)
+  {
+    int sensorId = 5000000 + (index * SENSORS_PER_DEVICE + s) * 3;
+    int typeId = TYPE_IDS[(index * SENSORS_PER_DEVICE + s) % 6];
+    json sensor = {{"id", sensorId}, {"sensorName", typeId == 2 || typeId == 5 ? "开关" : "压力"}, {"isLine", 1},
+                   {"sensorTypeId", typeId}, {"updateDate", "2024-08-12 10:00:" + string(tick ? "31" : "30")}};
+    if (typeId == 1)
+    {
+      sensor["decimalPlacse"] = sensorId % 2 ? "2" : "0";
+      sensor["value"] = to_string(sensorId % 1000 + tick) + (sensorId % 2 ? ".25" : "");
+    }
+    else if (typeId == 2 || typeId == 5)
+    {
+      sensor["switcher"] = tick;
+    }
+    else
+    {
+      sensor["value"] = "v" + to_string(tick);
+    }
+    sensorsList.push_back(sensor);
+  }
+  return {{"id", 100000 + index * 7}, {"deviceName", "4G压力表"}, {"deviceNo", "SIM" + to_string(index)},
+          {"sensorsList", sensorsList}};
+}
+
+// 一页设备列表数据
+static string makePage(int devices)
+{
+  json dataList = json::array();
+  for (int d = 0; d < devices; d++)
+  {
+    dataList.push_back(makeDevice(d, d % 2));
+  }
+  return json({{"flag", "00"}, {"msg", ""}, {"rowCount", devices}, {"dataList", dataList}}).dump();
+}
+
+// 当前规模下的更新样本，两组数据交替使用
+struct Samples
+{
+  vector<json> devices[2];
+  vector<pair<Device *, json>> sensors[6][2];
+};
+
+static Samples samples;
+static size_t populated = 0;
+
+// 重建进程内服务器并填充指定传感器数的设备，规模不变时直接复用，不计入测量
+static void populate(size_t sensors)
+{
+  if (sensors == populated)
+  {
+    return;
+  }
+  if (opcServer != nullptr)
+  {
+    UA_Server_delete(opcServer);
+    registry.clear();
+  }
+  opcServer = UA_Server_new();
+  serverCfg = UA_Server_getConfig(opcServer);
+  serverCfg->logger = UA_Log_Stdout_withLevel(UA_LOGLEVEL_ERROR);
+  setLogLevel(UA_LOGLEVEL_ERROR);
+  folderNsIndex = UA_Server_addNamespace(opcServer, "folder");
+  deviceNsIndex = UA_Server_addNamespace(opcServer, "device");
+  sensorNsIndex = UA_Server_addNamespace(opcServer, "sensor");
+  createFolderObject(folderId, UA_NS0ID_OBJECTSFOLDER, "bench", "bench");
+  size_t devices = sensors / SENSORS_PER_DEVICE;
+  for (size_t d = 0; d < devices; d++)
+  {
+    updateDeviceData(makeDevice((int)d, 0));
+  }
+
+  samples = Samples();
+  // 样本数量有上限，仍均匀覆盖整个规模，访问模式与按页更新相近
+  size_t step = max<size_t>(devices / 4096, 1);
+  for (size_t d = 0; d < devices; d += step)
+  {
+    for (int tick = 0; tick < 2; tick++)
+    {
+      json device = makeDevice((int)d, tick ? 1 : 2);
+      Device *target = registry.findDevice(device["id"]);
+      for (json &sensor : device["sensorsList"])
+      {
+        int type = find(begin(TYPE_IDS), end(TYPE_IDS), (int)sensor["sensorTypeId"]) - begin(TYPE_IDS);
+        samples.sensors[type][tick].emplace_back(target, sensor);
+      }
+      samples.devices[tick].push_back(device);
+    }
+  }
+  populated = sensors;
+}
+
+static void BM_JsonParse(benchmark::State &state)
+{
+  string page = makePage((int)state.range(0));
+  for (auto _ : state)
+  {
+    json data = json::parse(page);
+    benchmark::DoNotOptimize(data);
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(state.iterations() * page.size());
+}
+
+static void BM_UpdateDeviceData(benchmark::State &state)
+{
+  populate(state.range(0));
+  size_t count = samples.devices[0].size();
+  size_t i = 0;
+  for (auto _ : state)
+  {
+    updateDeviceData(samples.devices[i / count % 2][i % count]);
+    i++;
+  }
+  state.SetItemsProcessed(state.iterations() * SENSORS_PER_DEVICE);
+}
+
+static void BM_UpdateSensorData(benchmark::State &state)
+{
+  int type = find(begin(TYPE_IDS), end(TYPE_IDS), (int)state.range(0)) - begin(TYPE_IDS);
+  populate(state.range(1));
+  size_t count = samples.sensors[type][0].size();
+  size_t i = 0;
+  for (auto _ : state)
+  {
+    auto &sample = samples.sensors[type][i / count % 2][i % count];
+    updateSensorData(sample.first, sample.second);
+    i++;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_UpdateVariable(benchmark::State &state)
+{
+  populate(state.range(0));
+  size_t count = registry.sensors.size();
+  size_t i = 0;
+  for (auto _ : state)
+  {
+    Sensor *sensor = &registry.sensors[i % count];
+    ValueVariant variant(sensor);
+    updateVariable(sensor->sensorId, UA_STATUSCODE_GOOD, (UA_DateTime)i, variant.variant);
+    i++;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_CreateSensorVariable(benchmark::State &state)
+{
+  populate(state.range(0));
+  Device *parent = &registry.devices[0];
+  ValueVariant variant(&registry.sensors[0]);
+  // 新节点的ID在合成数据的范围之外，测量后删除，规模保持不变
+  int first = 900000000;
+  int created = 0;
+  for (auto _ : state)
+  {
+    createSensorVariable(first + created, parent->deviceId, "压力", "压力", variant.variant, NULL);
+    created++;
+  }
+  for (int i = 0; i < created; i++)
+  {
+    UA_Server_deleteNode(opcServer, UA_NODEID_NUMERIC(sensorNsIndex, first + i), true);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+int main(int argc, char *argv[])
+{
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv))
+  {
+    return 1;
+  }
+  // 与规模无关的页解析在前，其余按规模分组注册，同一规模的测量共用一次填充
+  benchmark::RegisterBenchmark("BM_JsonParse", BM_JsonParse)->ArgName("devices")->Arg(10)->Arg(100)->Arg(500);
+  for (int size : SIZES)
+  {
+    benchmark::RegisterBenchmark("BM_UpdateDeviceData", BM_UpdateDeviceData)->ArgName("sensors")->Arg(size);
+    for (int type : TYPE_IDS)
+    {
+      benchmark::RegisterBenchmark("BM_UpdateSensorData", BM_UpdateSensorData)->ArgNames({"type", "sensors"})->Args({type, size});
+    }
+    benchmark::RegisterBenchmark("BM_UpdateVariable", BM_UpdateVariable)->ArgName("sensors")->Arg(size);
+    benchmark::RegisterBenchmark("BM_CreateSensorVariable", BM_CreateSensorVariable)->ArgName("sensors")->Arg(size);
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
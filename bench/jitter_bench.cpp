@@ -0,0 +1,179 @@
+//
+//  jitter_bench.cpp
+//
+//  测量拉取和解码负载下网络循环发布间隔的抖动，对比不绑定和按线程角色绑定CPU及优先级两种情况
+//  发布线程模拟网络循环中的发布定时器，按固定间隔以绝对时间睡眠，醒来后编码一批变量值，
+//  记录实际醒来时间相对计划时间的延迟和相邻两次发布的间隔；负载线程模拟拉取和解码线程，
+//  持续解析设备页数据；绑定时发布线程使用network角色，负载线程使用decode角色，
+//  角色设置与服务端threadRoles配置相同，使用include/affinity.h
+//
+//  编译: g++ -O2 -std=c++17 -pthread bench/jitter_bench.cpp -o jitter_bench
+//  运行: ./jitter_bench [秒数] [发布间隔毫秒] [负载线程数] [network CPU] [负载CPU] [network nice] [负载nice] [network实时优先级]
+//  例如: ./jitter_bench 10 5 4 0 1-3 -10 10 0
+//
+
+#include "../include/affinity.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using json = nlohmann::json;
+
+static int64_t nowNs()
+{
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// 与fleet_sim格式相同的一页设备数据
+static string makePage()
+{
+  json dataList = json::array();
+  for (int d = 0; d < 100; d++)
+  {
+    json sensorsList = json::array();
+    for (int s = 0; s < 10; s++)
+    {
+      sensorsList.push_back({{"id", 5000000 + (d * 10 + s) * 3}, {"sensorName", "压力"}, {"isLine", 1}, {"sensorTypeId", 1},
+                             {"updateDate", "2024-08-12 10:00:00"}, {"decimalPlacse", "2"}, {"value", "12.25"}});
+    }
+    dataList.push_back({{"id", 100000 + d * 7}, {"deviceName", "4G压力表"}, {"deviceNo", "SIM" + to_string(d)}, {"sensorsList", sensorsList}});
+  }
+  return json({{"flag", "00"}, {"msg", ""}, {"rowCount", 100}, {"dataList", dataList}}).dump();
+}
+
+struct Result
+{
+  vector<int64_t> lateness;
+  vector<int64_t> intervals;
+  size_t pages = 0;
+};
+
+static void applyRole(const char *name, const ThreadRole &role, bool pin)
+{
+  string error;
+  if (pin && !applyThreadRole(role, error))
+  {
+    printf("  %s: %s\n", name, error.c_str());
+  }
+}
+
+static Result run(bool pin, double seconds, int intervalMs, int loadThreads, const ThreadRole &network, const ThreadRole &load)
+{
+  Result result;
+  atomic<bool> stop{false};
+  atomic<size_t> pages{0};
+  string page = makePage();
+  vector<thread> workers;
+  for (int i = 0; i < loadThreads; i++)
+  {
+    workers.emplace_back([&]()
+    {
+      applyRole("decode", load, pin);
+      while (!stop)
+      {
+        json data = json::parse(page);
+        pages += data["dataList"].size() > 0;
+      }
+    });
+  }
+
+  thread publisher([&]()
+  {
+    applyRole("network", network, pin);
+    // 每次发布编码一批变量值，模拟发布响应的工作量
+    vector<double> values(1000, 12.25);
+    string encoded;
+    int64_t interval = (int64_t)intervalMs * 1000000;
+    int64_t end = nowNs() + (int64_t)(seconds * 1e9);
+    int64_t deadline = nowNs() + interval;
+    int64_t last = 0;
+    while (deadline < end)
+    {
+      timespec ts = {(time_t)(deadline / 1000000000), (long)(deadline % 1000000000)};
+      clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr);
+      int64_t woke = nowNs();
+      result.lateness.push_back(woke - deadline);
+      if (last != 0)
+      {
+        result.intervals.push_back(woke - last);
+      }
+      last = woke;
+      encoded.clear();
+      for (double value : values)
+      {
+        encoded += to_string(value);
+      }
+      deadline += interval;
+    }
+  });
+  publisher.join();
+  stop = true;
+  for (thread &t : workers)
+  {
+    t.join();
+  }
+  result.pages = pages;
+  return result;
+}
+
+static void report(const char *name, Result &result, int intervalMs)
+{
+  sort(result.lateness.begin(), result.lateness.end());
+  auto quantile = [&result](double q)
+  {
+    return result.lateness.empty() ? 0 : result.lateness[min(result.lateness.size() - 1, (size_t)(result.lateness.size() * q))];
+  };
+  // 发布间隔相对设定间隔的标准差
+  double sum = 0;
+  for (int64_t value : result.intervals)
+  {
+    double diff = value - intervalMs * 1e6;
+    sum += diff * diff;
+  }
+  double jitter = result.intervals.empty() ? 0 : sqrt(sum / result.intervals.size());
+  printf("%-6s %8zu %10.1f %10.1f %10.1f %10.1f %12.1f %10zu\n", name, result.lateness.size(), quantile(0.5) / 1000.0,
+         quantile(0.99) / 1000.0, quantile(0.999) / 1000.0, result.lateness.empty() ? 0 : result.lateness.back() / 1000.0,
+         jitter / 1000.0, result.pages);
+  fflush(stdout);
+}
+
+int main(int argc, char *argv[])
+{
+  double seconds = argc > 1 ? atof(argv[1]) : 10;
+  int intervalMs = argc > 2 ? max(atoi(argv[2]), 1) : 5;
+  int loadThreads = argc > 3 ? atoi(argv[3]) : 4;
+  ThreadRole network;
+  ThreadRole load;
+  if ((argc > 4 && !parseCpuList(argv[4], network.cpus)) || (argc > 5 && !parseCpuList(argv[5], load.cpus)))
+  {
+    printf("invalid cpu list\n");
+    return 1;
+  }
+  network.setNice = true;
+  network.nice = argc > 6 ? atoi(argv[6]) : -10;
+  load.setNice = true;
+  load.nice = argc > 7 ? atoi(argv[7]) : 10;
+  network.realtime = argc > 8 ? atoi(argv[8]) : 0;
+
+  printf("seconds=%.1f interval=%dms load_threads=%d cpus=%u network=[%s nice %d rt %d] load=[%s nice %d]\n", seconds,
+         intervalMs, loadThreads, thread::hardware_concurrency(), formatCpuList(network.cpus).c_str(), network.nice,
+         network.realtime, formatCpuList(load.cpus).c_str(), load.nice);
+  printf("%-6s %8s %10s %10s %10s %10s %12s %10s\n", "mode", "wakes", "p50_us", "p99_us", "p999_us", "max_us", "jitter_us",
+         "pages");
+  Result off = run(false, seconds, intervalMs, loadThreads, network, load);
+  report("off", off, intervalMs);
+  Result on = run(true, seconds, intervalMs, loadThreads, network, load);
+  report("pinned", on, intervalMs);
+  return 0;
+}
@@ -0,0 +1,94 @@
+//
+//  journal_bench.cpp
+//
+//  测量变更日志按页组提交并等待落盘的追加吞吐量、每次落盘的耗时以及回放速度
+//
+//  编译: g++ -O2 -std=c++17 -pthread bench/journal_bench.cpp -o journal_bench
+//  运行: ./journal_bench [传感器数] [每页记录数] [周期数]
+//
+
+#include "../include/journal.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace std;
+
+// 与server.cpp中JournalRecord布局相同的记录
+struct JournalRecord
+{
+  uint32_t slot;
+  int32_t sensorId;
+  uint32_t status;
+  uint32_t textLength;
+  int64_t updateTs;
+  double number;
+  uint8_t valueType;
+  uint8_t reserved[7];
+};
+
+static double seconds(chrono::steady_clock::time_point start)
+{
+  return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char *argv[])
+{
+  size_t sensorCount = argc > 1 ? atoi(argv[1]) : 100000;
+  size_t pageSize = argc > 2 ? atoi(argv[2]) : 1000;
+  int cycles = argc > 3 ? atoi(argv[3]) : 3;
+  const char *path = "journal_bench.log";
+  remove(path);
+
+  Journal journal;
+  if (!journal.open(path))
+  {
+    printf("open failed\n");
+    return 1;
+  }
+
+  // 每个周期所有传感器都有变化，每页组提交一次并等待写线程落盘
+  size_t total = sensorCount * cycles;
+  auto start = chrono::steady_clock::now();
+  double commitSeconds = 0;
+  for (int cycle = 0; cycle < cycles; cycle++)
+  {
+    for (size_t i = 0; i < sensorCount; i++)
+    {
+      JournalRecord record = {};
+      record.slot = (uint32_t)i;
+      record.sensorId = (int32_t)(5000000 + i * 3);
+      record.updateTs = 1723456800 + cycle * 10;
+      record.number = (double)(i + cycle);
+      record.valueType = 1;
+      journal.append(&record, sizeof(record));
+      if ((i + 1) % pageSize == 0 || i + 1 == sensorCount)
+      {
+        auto commitStart = chrono::steady_clock::now();
+        journal.sync();
+        commitSeconds += seconds(commitStart);
+      }
+    }
+  }
+  double appendSeconds = seconds(start);
+  journal.close();
+
+  // 回放
+  start = chrono::steady_clock::now();
+  double sum = 0;
+  size_t replayed = Journal::replay(path, [&sum](const char *data, uint32_t)
+  {
+    JournalRecord record;
+    memcpy(&record, data, sizeof(record));
+    sum += record.number;
+  });
+  double replaySeconds = seconds(start);
+
+  printf("sensors=%zu page=%zu cycles=%d commits=%zu check=%.0f\n", sensorCount, pageSize, cycles, journal.commits, sum);
+  printf("append:  %.2f Mrec/s, %.1f us per commit, %zu bytes\n", total / appendSeconds / 1e6,
+         commitSeconds / journal.commits * 1e6, total * (sizeof(JournalRecord) + 8));
+  printf("replay:  %.2f Mrec/s (%zu records)\n", replayed / replaySeconds / 1e6, replayed);
+  remove(path);
+  return replayed == total ? 0 : 1;
+}
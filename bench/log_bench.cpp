@@ -0,0 +1,162 @@
+//
+//  log_bench.cpp
+//
+//  在ERROR级别下模拟稳态拉取周期中的日志调用，对比直接调用UA_LOG_*和使用include/log.h日志门面的
+//  堆分配次数和耗时；每个传感器写入一次数值并记录写入结果，懒加载比例的传感器重新创建节点并记录
+//  创建结果，格式错误比例的传感器记录警告和原始JSON，与服务端对应调用点的参数相同
+//
+//  直接调用时拼接字符串和序列化JSON在级别判断之前发生，日志门面在级别未启用时不求值参数，
+//  分配次数应为0；编译期下限默认设为TRACE以测量运行时判断，-DOPC_LOG_FLOOR=300时DEBUG调用在编译期消除
+//
+//  编译: g++ -O2 -std=c++17 bench/log_bench.cpp -o log_bench -lopen62541
+//  运行: ./log_bench [传感器数] [周期数] [懒加载比例] [格式错误比例]
+//  例如: ./log_bench 100000 10 0.05 0.001
+//
+
+#ifndef OPC_LOG_FLOOR
+#define OPC_LOG_FLOOR 100
+#endif
+#include "../include/log.h"
+#include <nlohmann/json.hpp>
+#include <open62541/plugin/log_stdout.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+using namespace std;
+using json = nlohmann::json;
+
+// 统计堆分配次数
+static atomic<size_t> allocations{0};
+
+void *operator new(size_t size)
+{
+  allocations.fetch_add(1, memory_order_relaxed);
+  void *ptr = malloc(size ? size : 1);
+  if (ptr == nullptr)
+  {
+    throw bad_alloc();
+  }
+  return ptr;
+}
+
+void operator delete(void *ptr) noexcept
+{
+  free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+  free(ptr);
+}
+
+static UA_Logger logger;
+
+struct Record
+{
+  const char *name;
+  bool materialize;
+  bool malformed;
+  json data;
+};
+
+// 修改前服务端的调用方式，参数在调用日志函数之前求值
+static void eagerCycle(const vector<Record> &records)
+{
+  for (const Record &record : records)
+  {
+    if (record.malformed)
+    {
+      UA_LOG_WARNING(&logger, UA_LOGCATEGORY_SERVER, "未找到传感器参数value");
+      UA_LOG_DEBUG(&logger, UA_LOGCATEGORY_SERVER, "%s", to_string(record.data).c_str());
+      continue;
+    }
+    if (record.materialize)
+    {
+      string status(UA_StatusCode_name(UA_STATUSCODE_GOOD));
+      string msg = status + "|创建OPC传感器变量" + "[" + string(record.name) + "]";
+      UA_LOG_DEBUG(&logger, UA_LOGCATEGORY_SERVER, "%s", msg.c_str());
+    }
+    const char *mv = "写入数值成功";
+    UA_LOG_DEBUG(&logger, UA_LOGCATEGORY_SERVER, "%s", mv);
+  }
+}
+
+// 使用日志门面，与服务端当前的调用方式相同
+static void facadeCycle(const vector<Record> &records)
+{
+  for (const Record &record : records)
+  {
+    if (record.malformed)
+    {
+      OPC_LOG_WARNING(&logger, UA_LOGCATEGORY_SERVER, "未找到传感器参数value");
+      OPC_LOG_DEBUG(&logger, UA_LOGCATEGORY_SERVER, "%s", to_string(record.data).c_str());
+      continue;
+    }
+    if (record.materialize)
+    {
+      OPC_LOG_DEBUG(&logger, UA_LOGCATEGORY_SERVER, "%s|创建OPC传感器变量[%s]", UA_StatusCode_name(UA_STATUSCODE_GOOD),
+                    record.name);
+    }
+    OPC_LOG_DEBUG(&logger, UA_LOGCATEGORY_SERVER, "写入数值成功");
+  }
+}
+
+template <typename F>
+static void run(const char *name, F cycle, const vector<Record> &records, int cycles)
+{
+  size_t before = allocations.load();
+  auto start = chrono::steady_clock::now();
+  for (int c = 0; c < cycles; c++)
+  {
+    cycle(records);
+  }
+  double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+  size_t count = allocations.load() - before;
+  printf("%-7s %14zu %16.3f %14.2f\n", name, count, (double)count / cycles / records.size(),
+         ns / cycles / records.size());
+  fflush(stdout);
+}
+
+int main(int argc, char *argv[])
+{
+  int sensors = argc > 1 ? atoi(argv[1]) : 100000;
+  int cycles = argc > 2 ? atoi(argv[2]) : 10;
+  double lazyRate = argc > 3 ? atof(argv[3]) : 0.05;
+  double badRate = argc > 4 ? atof(argv[4]) : 0.001;
+
+  logger = UA_Log_Stdout_withLevel(UA_LOGLEVEL_ERROR);
+  setLogLevel(UA_LOGLEVEL_ERROR);
+
+  // 按比例均匀分布懒加载和格式错误的传感器
+  vector<Record> records(sensors);
+  double lazyAcc = 0;
+  double badAcc = 0;
+  for (int i = 0; i < sensors; i++)
+  {
+    Record &record = records[i];
+    record.name = i % 2 ? "压力" : "开关";
+    lazyAcc += lazyRate;
+    badAcc += badRate;
+    record.materialize = lazyAcc >= 1;
+    record.malformed = badAcc >= 1;
+    lazyAcc -= record.materialize ? 1 : 0;
+    badAcc -= record.malformed ? 1 : 0;
+    if (record.malformed)
+    {
+      record.data = {{"id", 5000000 + i * 3}, {"sensorName", record.name}, {"isLine", 1}, {"sensorTypeId", 1},
+                     {"updateDate", "2024-08-12 10:00:00"}, {"decimalPlacse", "2"}};
+    }
+  }
+
+  printf("sensors=%d cycles=%d lazy=%.3f malformed=%.4f level=ERROR floor=%d\n", sensors, cycles, lazyRate, badRate,
+         OPC_LOG_FLOOR);
+  printf("%-7s %14s %16s %14s\n", "mode", "allocations", "allocs_per_sensor", "ns_per_sensor");
+  run("eager", eagerCycle, records, cycles);
+  run("facade", facadeCycle, records, cycles);
+  return 0;
+}
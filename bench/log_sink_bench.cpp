@@ -0,0 +1,72 @@
+//
+//  log_sink_bench.cpp
+//
+//  在DEBUG级别下对比同步的UA_Log_Stdout和include/async_log.h异步日志器的单次日志调用耗时
+//  模拟服务器网络循环按固定间隔输出调试日志，日志写到标准输出，结果写到标准错误；
+//  标准输出接到慢速管道时同步日志器的调用耗时随管道写入阻塞，异步日志器只有格式化和入队的开销，
+//  缓冲区写满时丢弃记录并计数
+//
+//  编译: g++ -O2 -std=c++17 -pthread bench/log_sink_bench.cpp -o log_sink_bench -lopen62541
+//  运行: ./log_sink_bench [记录数] [调用间隔微秒] [消息字节数] [缓冲区记录数] | [慢速读取端]
+//  例如: ./log_sink_bench 20000 50 120 4096 | (sleep 1; pv -q -L 500k > /dev/null)
+//
+
+#include "../include/async_log.h"
+#include <open62541/plugin/log_stdout.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+static void run(const char *name, const UA_Logger &logger, int records, int intervalUs, const string &payload,
+                AsyncLog *async)
+{
+  vector<double> costs;
+  costs.reserve(records);
+  auto next = chrono::steady_clock::now();
+  auto begin = next;
+  for (int i = 0; i < records; i++)
+  {
+    auto start = chrono::steady_clock::now();
+    UA_LOG_DEBUG(&logger, UA_LOGCATEGORY_SERVER, "写入数值成功|传感器: %d, 数值: %s", 5000000 + i * 3, payload.c_str());
+    costs.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - start).count());
+    next += chrono::microseconds(intervalUs);
+    this_thread::sleep_until(next);
+  }
+  double wall = chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+  sort(costs.begin(), costs.end());
+  auto quantile = [&costs](double q)
+  {
+    return costs[min(costs.size() - 1, (size_t)(costs.size() * q))];
+  };
+  fprintf(stderr, "%-6s %10.2f %10.2f %10.2f %10.1f %10.0f %10zu\n", name, quantile(0.5), quantile(0.99),
+          quantile(0.999), costs.back(), wall, async ? async->dropped() : 0);
+}
+
+int main(int argc, char *argv[])
+{
+  int records = argc > 1 ? max(atoi(argv[1]), 1) : 20000;
+  int intervalUs = argc > 2 ? atoi(argv[2]) : 50;
+  int bytes = argc > 3 ? atoi(argv[3]) : 120;
+  int buffer = argc > 4 ? atoi(argv[4]) : 4096;
+  string payload(max(bytes, 1), 'x');
+
+  fprintf(stderr, "records=%d interval=%dus bytes=%d buffer=%d level=DEBUG\n", records, intervalUs, bytes, buffer);
+  fprintf(stderr, "%-6s %10s %10s %10s %10s %10s %10s\n", "sink", "p50_us", "p99_us", "p999_us", "max_us", "wall_ms",
+          "dropped");
+  UA_Logger stdoutLogger = UA_Log_Stdout_withLevel(UA_LOGLEVEL_DEBUG);
+  run("stdout", stdoutLogger, records, intervalUs, payload, nullptr);
+
+  AsyncLog async;
+  async.start(buffer, UA_LOGLEVEL_DEBUG);
+  UA_Logger asyncLogger = async.logger();
+  run("async", asyncLogger, records, intervalUs, payload, &async);
+  async.stop();
+  fprintf(stderr, "async written=%zu dropped=%zu\n", async.written(), async.dropped());
+  return 0;
+}
@@ -0,0 +1,243 @@
+//
+//  loop_latency_bench.cpp
+//
+//  对比阻塞拉取和epoll事件循环两种模式下服务循环对客户端请求的响应延迟
+//  服务循环用回显套接字代替OPC-UA客户端连接，客户端线程每毫秒发送一个字节并测量往返时间，
+//  循环同时每隔一段时间从fleet_sim分页拉取全部数据并解析：
+//  阻塞模式与UA_Server_run中的httplib回调相同，拉取期间循环不处理客户端请求；
+//  事件循环模式与eventLoop配置相同，HTTP请求在同一个epoll上非阻塞进行
+//
+//  编译: g++ -O2 -std=c++17 -pthread bench/loop_latency_bench.cpp -o loop_latency_bench -lssl -lcrypto
+//  运行: ./fleet_sim 2000 10 0.1 0.05 18080
+//        ./loop_latency_bench [接口地址] [秒数] [拉取间隔毫秒]
+//
+
+#define CPPHTTPLIB_OPENSSL_SUPPORT
+#include "../include/httplib.h"
+#include "../include/async_http.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <poll.h>
+#include <sys/socket.h>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using json = nlohmann::json;
+
+static int64_t nowUs()
+{
+  return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// 解析一页数据，返回是否还有下一页，与服务端的分页规则相同
+static bool parsePage(const string &body, int page, int size, size_t &sensors)
+{
+  json data = json::parse(body, nullptr, false);
+  if (data.is_discarded() || !data["dataList"].is_array())
+  {
+    return false;
+  }
+  for (auto &device : data["dataList"])
+  {
+    sensors += device["sensorsList"].size();
+  }
+  int total = data["rowCount"];
+  return data["dataList"].size() == (size_t)size && page * size < total;
+}
+
+struct Result
+{
+  vector<int64_t> rtts;
+  vector<int64_t> cycles;
+  size_t sensors = 0;
+};
+
+// 客户端线程，每毫秒发送一次并等待回显
+static void pinger(int fd, atomic<bool> &stop, vector<int64_t> &rtts)
+{
+  char byte = 'p';
+  while (!stop)
+  {
+    int64_t start = nowUs();
+    if (send(fd, &byte, 1, 0) != 1)
+    {
+      break;
+    }
+    pollfd pfd = {fd, POLLIN, 0};
+    if (poll(&pfd, 1, 1000) <= 0 || recv(fd, &byte, 1, 0) != 1)
+    {
+      continue;
+    }
+    rtts.push_back(nowUs() - start);
+    this_thread::sleep_for(chrono::milliseconds(1));
+  }
+}
+
+static string pageBody(int page)
+{
+  return json({{"userId", 1}, {"currPage", page}, {"pageSize", 100}}).dump();
+}
+
+// 阻塞模式：循环等待客户端请求，到拉取时间后同步拉取所有页
+static Result runBlocking(const string &url, double seconds, int intervalMs)
+{
+  Result result;
+  int pair[2];
+  socketpair(AF_UNIX, SOCK_STREAM, 0, pair);
+  atomic<bool> stop{false};
+  thread client(pinger, pair[1], ref(stop), ref(result.rtts));
+  int64_t end = nowUs() + (int64_t)(seconds * 1e6);
+  int64_t nextPoll = nowUs();
+  while (nowUs() < end)
+  {
+    int timeout = (int)max<int64_t>(0, (nextPoll - nowUs()) / 1000);
+    pollfd pfd = {pair[0], POLLIN, 0};
+    if (poll(&pfd, 1, timeout) > 0)
+    {
+      char byte;
+      if (recv(pair[0], &byte, 1, 0) == 1)
+      {
+        send(pair[0], &byte, 1, 0);
+      }
+    }
+    if (nowUs() >= nextPoll)
+    {
+      int64_t start = nowUs();
+      httplib::Client cli(url);
+      cli.set_keep_alive(true);
+      cli.set_bearer_token_auth("fleet-sim-token");
+      auto token = cli.Post("/oauth/token", httplib::Params{{"grant_type", "password"}});
+      for (int page = 1; token; page++)
+      {
+        auto res = cli.Post("/api/device/getDeviceSensorDatas", pageBody(page), "application/json");
+        if (!res || !parsePage(res->body, page, 100, result.sensors))
+        {
+          break;
+        }
+      }
+      result.cycles.push_back(nowUs() - start);
+      nextPoll = start + intervalMs * 1000;
+    }
+  }
+  stop = true;
+  client.join();
+  close(pair[0]);
+  close(pair[1]);
+  return result;
+}
+
+// 事件循环模式：客户端请求和HTTP请求在同一个epoll上处理
+static Result runEventLoop(const string &url, double seconds, int intervalMs)
+{
+  Result result;
+  int pair[2];
+  socketpair(AF_UNIX, SOCK_STREAM, 0, pair);
+  int ep = epoll_create1(EPOLL_CLOEXEC);
+  epoll_event event = {};
+  event.events = EPOLLIN;
+  // 回显套接字使用最大的标签，与AsyncHttp的连接区分
+  event.data.u64 = UINT64_MAX;
+  epoll_ctl(ep, EPOLL_CTL_ADD, pair[0], &event);
+  AsyncHttp http;
+  http.init(ep, url, 30000);
+  atomic<bool> stop{false};
+  thread client(pinger, pair[1], ref(stop), ref(result.rtts));
+
+  int64_t end = nowUs() + (int64_t)(seconds * 1e6);
+  int64_t nextPoll = nowUs();
+  int64_t cycleStart = 0;
+  bool inFlight = false;
+  AsyncHttp::Headers headers = {{"Authorization", "Bearer fleet-sim-token"}, {"Content-Type", "application/json"}};
+  function<void(int)> fetch = [&](int page)
+  {
+    http.request("POST", "/api/device/getDeviceSensorDatas", headers, pageBody(page),
+                 [&, page](const AsyncHttp::Response &res)
+                 {
+                   if (!res.body.empty() && parsePage(res.body, page, 100, result.sensors))
+                   {
+                     fetch(page + 1);
+                     return;
+                   }
+                   result.cycles.push_back(nowUs() - cycleStart);
+                   inFlight = false;
+                 });
+  };
+
+  epoll_event events[64];
+  while (nowUs() < end)
+  {
+    if (!inFlight && nowUs() >= nextPoll)
+    {
+      inFlight = true;
+      cycleStart = nowUs();
+      nextPoll = cycleStart + intervalMs * 1000;
+      http.request("POST", "/oauth/token", {{"Content-Type", "application/x-www-form-urlencoded"}}, "grant_type=password",
+                   [&](const AsyncHttp::Response &)
+                   {
+                     fetch(1);
+                   });
+    }
+    int timeout = inFlight ? 1000 : (int)max<int64_t>(0, (nextPoll - nowUs()) / 1000);
+    int count = epoll_wait(ep, events, 64, timeout);
+    for (int i = 0; i < count; i++)
+    {
+      if (events[i].data.u64 == UINT64_MAX)
+      {
+        char byte;
+        if (recv(pair[0], &byte, 1, 0) == 1)
+        {
+          send(pair[0], &byte, 1, 0);
+        }
+      }
+      else
+      {
+        http.handle(events[i].data.u64, events[i].events);
+      }
+    }
+    http.expire();
+  }
+  stop = true;
+  client.join();
+  http.cancelAll();
+  close(pair[0]);
+  close(pair[1]);
+  close(ep);
+  return result;
+}
+
+static void report(const char *name, Result &result)
+{
+  sort(result.rtts.begin(), result.rtts.end());
+  auto quantile = [&result](double q)
+  {
+    return result.rtts.empty() ? 0 : result.rtts[min(result.rtts.size() - 1, (size_t)(result.rtts.size() * q))];
+  };
+  int64_t cycle = 0;
+  for (int64_t c : result.cycles)
+  {
+    cycle += c;
+  }
+  printf("%-10s %8zu %10lld %10lld %10lld %10lld %8zu %10lld\n", name, result.rtts.size(), (long long)quantile(0.5),
+         (long long)quantile(0.99), (long long)quantile(0.999), (long long)(result.rtts.empty() ? 0 : result.rtts.back()),
+         result.cycles.size(), (long long)(result.cycles.empty() ? 0 : cycle / (int64_t)result.cycles.size() / 1000));
+}
+
+int main(int argc, char *argv[])
+{
+  string url = argc > 1 ? argv[1] : "http://127.0.0.1:18080";
+  double seconds = argc > 2 ? atof(argv[2]) : 10;
+  int intervalMs = argc > 3 ? atoi(argv[3]) : 2000;
+
+  printf("url=%s seconds=%.1f interval=%dms\n", url.c_str(), seconds, intervalMs);
+  printf("%-10s %8s %10s %10s %10s %10s %8s %10s\n", "mode", "pings", "p50_us", "p99_us", "p999_us", "max_us", "cycles", "cycle_ms");
+  Result blocking = runBlocking(url, seconds, intervalMs);
+  report("blocking", blocking);
+  Result loop = runEventLoop(url, seconds, intervalMs);
+  report("eventloop", loop);
+  return 0;
+}
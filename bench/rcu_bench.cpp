@@ -0,0 +1,203 @@
+//
+//  rcu_bench.cpp
+//
+//  8个读线程随机查询传感器，1个写线程全速应用更新，对比读写锁保护的共享注册表
+//  与写线程发布不可变版本、读线程按纪元固定版本两种方式的读吞吐量、读延迟和写吞吐量
+//
+//  编译: g++ -O2 -std=c++17 -pthread bench/rcu_bench.cpp -o rcu_bench
+//  运行: ./rcu_bench [传感器数] [每次发布的更新数] [读线程数] [秒数]
+//
+
+#include "../include/flat_index.h"
+#include "../include/rcu.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// 与server.cpp中Sensor布局相同的紧凑记录
+struct alignas(32) Sensor
+{
+  int sensorId;
+  uint32_t deviceSlot;
+  uint32_t status;
+  uint8_t typeId;
+  uint8_t valueType;
+  bool materialized;
+  int64_t updateTs;
+  union
+  {
+    double number;
+    uint32_t text;
+  } value;
+};
+
+// 发布的版本，结构部分共用
+struct View
+{
+  const FlatIndex *index;
+  vector<Sensor> sensors;
+};
+
+// 每次读取查询的传感器数
+static const int LOOKUPS = 16;
+
+struct Result
+{
+  double readMops;
+  double readP50;
+  double readP99;
+  double writeMops;
+};
+
+static Result run(bool useRcu, size_t sensorCount, size_t batch, int readers, double duration)
+{
+  FlatIndex index;
+  vector<Sensor> sensors(sensorCount);
+  vector<int> ids(sensorCount);
+  for (size_t i = 0; i < sensorCount; i++)
+  {
+    ids[i] = (int)(5000000 + i * 3);
+    sensors[i] = Sensor{};
+    sensors[i].sensorId = ids[i];
+    sensors[i].valueType = 1;
+    index.insert((uint32_t)ids[i], (uint32_t)i);
+  }
+
+  shared_mutex lock;
+  Rcu<View> views;
+  views.publish(new View{&index, sensors});
+
+  atomic<bool> stop{false};
+  atomic<size_t> writes{0};
+  vector<size_t> reads(readers, 0);
+  vector<vector<uint32_t>> latencies(readers);
+
+  // 写线程，按批应用更新，读写锁方式在批内持有写锁，发布方式在批后发布新版本
+  thread writer([&]()
+  {
+    size_t next = 0;
+    int64_t ts = 1723456800;
+    while (!stop.load(memory_order_relaxed))
+    {
+      {
+        unique_lock<shared_mutex> guard(lock, defer_lock);
+        if (!useRcu)
+        {
+          guard.lock();
+        }
+        for (size_t i = 0; i < batch; i++)
+        {
+          Sensor &sensor = sensors[next];
+          sensor.updateTs = ts;
+          sensor.value.number += 1;
+          next = next + 1 == sensorCount ? 0 : next + 1;
+        }
+      }
+      ts++;
+      if (useRcu)
+      {
+        views.publish(new View{&index, sensors});
+      }
+      writes.fetch_add(batch, memory_order_relaxed);
+    }
+  });
+
+  vector<thread> threads;
+  for (int r = 0; r < readers; r++)
+  {
+    threads.emplace_back([&, r]()
+    {
+      Rcu<View>::Reader reader(views);
+      // 纪元槽用尽的读线程不参与
+      if (useRcu && !reader.valid())
+      {
+        return;
+      }
+      mt19937 rng(r + 1);
+      uniform_int_distribution<size_t> pick(0, sensorCount - 1);
+      double sum = 0;
+      while (!stop.load(memory_order_relaxed))
+      {
+        int keys[LOOKUPS];
+        for (int k = 0; k < LOOKUPS; k++)
+        {
+          keys[k] = ids[pick(rng)];
+        }
+        auto start = chrono::steady_clock::now();
+        if (useRcu)
+        {
+          Rcu<View>::Guard view(reader);
+          for (int k = 0; k < LOOKUPS; k++)
+          {
+            sum += view->sensors[view->index->find((uint32_t)keys[k])].value.number;
+          }
+        }
+        else
+        {
+          shared_lock<shared_mutex> guard(lock);
+          for (int k = 0; k < LOOKUPS; k++)
+          {
+            sum += sensors[index.find((uint32_t)keys[k])].value.number;
+          }
+        }
+        auto ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+        if ((reads[r]++ & 15) == 0)
+        {
+          latencies[r].push_back((uint32_t)min<long long>(ns, UINT32_MAX));
+        }
+      }
+      if (sum < 0)
+      {
+        printf("%f\n", sum);
+      }
+    });
+  }
+
+  this_thread::sleep_for(chrono::duration<double>(duration));
+  stop = true;
+  writer.join();
+  for (thread &t : threads)
+  {
+    t.join();
+  }
+
+  size_t totalReads = 0;
+  vector<uint32_t> all;
+  for (int r = 0; r < readers; r++)
+  {
+    totalReads += reads[r];
+    all.insert(all.end(), latencies[r].begin(), latencies[r].end());
+  }
+  sort(all.begin(), all.end());
+  Result result;
+  result.readMops = totalReads * LOOKUPS / duration / 1e6;
+  result.readP50 = all.empty() ? 0 : all[all.size() / 2] / 1000.0;
+  result.readP99 = all.empty() ? 0 : all[all.size() * 99 / 100] / 1000.0;
+  result.writeMops = writes.load() / duration / 1e6;
+  return result;
+}
+
+int main(int argc, char *argv[])
+{
+  size_t sensorCount = argc > 1 ? atoi(argv[1]) : 100000;
+  size_t batch = argc > 2 ? atoi(argv[2]) : 10000;
+  int readers = argc > 3 ? atoi(argv[3]) : 8;
+  double duration = argc > 4 ? atof(argv[4]) : 2;
+
+  printf("sensors=%zu batch=%zu readers=%d seconds=%.1f lookups_per_read=%d\n", sensorCount, batch, readers, duration, LOOKUPS);
+  printf("%-8s %12s %12s %12s %12s\n", "impl", "read_Mlookup", "read_p50_us", "read_p99_us", "write_Mops");
+  Result locked = run(false, sensorCount, batch, readers, duration);
+  printf("%-8s %12.2f %12.2f %12.2f %12.2f\n", "rwlock", locked.readMops, locked.readP50, locked.readP99, locked.writeMops);
+  Result rcu = run(true, sensorCount, batch, readers, duration);
+  printf("%-8s %12.2f %12.2f %12.2f %12.2f\n", "rcu", rcu.readMops, rcu.readP50, rcu.readP99, rcu.writeMops);
+  return 0;
+}
@@ -0,0 +1,92 @@
+//
+//  read_latency_bench.cpp
+//
+//  OPC-UA客户端持续随机读取传感器变量并统计读延迟分位数，用于测量服务端在
+//  大量更新写入时对客户端请求的响应，配合fleet_sim产生写入负载，例如：
+//
+//  ./fleet_sim 100000 10 1.0 0 18080          每10秒周期更新100万个传感器，即每秒10万次写入
+//  启动服务端，config.json中apiUrl指向fleet_sim
+//  ./read_latency_bench opc.tcp://127.0.0.1:4840 1000000 60
+//
+//  分别用单线程和UA_MULTITHREADING构建的open62541编译服务端后对比p99
+//
+//  编译: g++ -O2 -std=c++17 bench/read_latency_bench.cpp -o read_latency_bench -lopen62541
+//  运行: ./read_latency_bench [服务地址] [传感器数] [秒数]
+//
+
+#include <open62541/client.h>
+#include <open62541/client_config_default.h>
+#include <open62541/client_highlevel.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+int main(int argc, char *argv[])
+{
+  const char *endpoint = argc > 1 ? argv[1] : "opc.tcp://127.0.0.1:4840";
+  size_t sensorCount = argc > 2 ? atoi(argv[2]) : 100000;
+  double duration = argc > 3 ? atof(argv[3]) : 30;
+
+  UA_Client *client = UA_Client_new();
+  UA_ClientConfig_setDefault(UA_Client_getConfig(client));
+  if (UA_Client_connect(client, endpoint) != UA_STATUSCODE_GOOD)
+  {
+    printf("connect failed: %s\n", endpoint);
+    UA_Client_delete(client);
+    return 1;
+  }
+
+  // 传感器变量所在的命名空间
+  UA_UInt16 sensorNsIndex = 0;
+  UA_String nsUri = UA_STRING((char *)"sensor");
+  if (UA_Client_NamespaceGetIndex(client, &nsUri, &sensorNsIndex) != UA_STATUSCODE_GOOD)
+  {
+    printf("namespace sensor not found\n");
+    UA_Client_delete(client);
+    return 1;
+  }
+
+  // 传感器ID与fleet_sim的生成规则一致
+  mt19937 rng(42);
+  uniform_int_distribution<size_t> pick(0, sensorCount - 1);
+  vector<uint32_t> latencies;
+  size_t failed = 0;
+  auto end = chrono::steady_clock::now() + chrono::duration<double>(duration);
+  while (chrono::steady_clock::now() < end)
+  {
+    UA_NodeId nodeId = UA_NODEID_NUMERIC(sensorNsIndex, (UA_UInt32)(5000000 + pick(rng) * 3));
+    UA_Variant value;
+    UA_Variant_init(&value);
+    auto start = chrono::steady_clock::now();
+    UA_StatusCode retval = UA_Client_readValueAttribute(client, nodeId, &value);
+    auto us = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+    UA_Variant_clear(&value);
+    if (retval != UA_STATUSCODE_GOOD)
+    {
+      failed++;
+      continue;
+    }
+    latencies.push_back((uint32_t)min<long long>(us, UINT32_MAX));
+  }
+  UA_Client_disconnect(client);
+  UA_Client_delete(client);
+
+  if (latencies.empty())
+  {
+    printf("no successful reads, failed=%zu\n", failed);
+    return 1;
+  }
+  sort(latencies.begin(), latencies.end());
+  auto quantile = [&latencies](double q)
+  {
+    return latencies[min(latencies.size() - 1, (size_t)(latencies.size() * q))];
+  };
+  printf("reads=%zu failed=%zu rate=%.0f/s\n", latencies.size(), failed, latencies.size() / duration);
+  printf("read_us p50=%u p99=%u p999=%u max=%u\n", quantile(0.5), quantile(0.99), quantile(0.999), latencies.back());
+  return 0;
+}
@@ -0,0 +1,251 @@
+//
+//  registry_bench.cpp
+//
+//  对比map<int, Device*>/map<int, Sensor*>、按设备和传感器两级查找的
+//  FlatIndex连续数组注册表以及按传感器ID全局索引的查找、更新吞吐量和
+//  每个传感器的内存占用，连续数组使用紧凑的32字节传感器记录
+//
+//  编译: g++ -O2 -std=c++17 bench/registry_bench.cpp -o registry_bench
+//  运行: ./registry_bench [设备数] [每设备传感器数]
+//
+
+#include "../include/flat_index.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+#include <malloc.h>
+
+using namespace std;
+
+// 统计当前存活的堆内存字节数
+static size_t allocatedBytes = 0;
+
+__attribute__((noinline)) void *operator new(size_t size)
+{
+  void *p = malloc(size);
+  if (p == nullptr)
+  {
+    throw bad_alloc();
+  }
+  allocatedBytes += malloc_usable_size(p);
+  return p;
+}
+
+__attribute__((noinline)) void operator delete(void *p) noexcept
+{
+  if (p != nullptr)
+  {
+    allocatedBytes -= malloc_usable_size(p);
+  }
+  free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+  operator delete(p);
+}
+
+// 原先的传感器记录，名称、时间字符串和UA_Variant都在记录内
+struct OldSensor
+{
+  int sensorId;
+  const string *sensorName;
+  string updateDate = "0000-00-00 00:00:00";
+  uint32_t status = 0;
+  // 对应UA_Variant
+  char value[48] = {};
+  bool materialized = false;
+};
+
+// 与server.cpp中Sensor布局相同的紧凑记录，名称在冷数据表中
+struct alignas(32) Sensor
+{
+  int sensorId;
+  uint32_t deviceSlot;
+  uint32_t status;
+  uint8_t typeId;
+  uint8_t valueType;
+  bool materialized;
+  int64_t updateTs;
+  union
+  {
+    double number;
+    uint32_t text;
+  } value;
+};
+
+struct MapDevice
+{
+  int deviceId;
+  map<int, OldSensor *> sensorList;
+};
+
+struct FlatDevice
+{
+  int deviceId;
+  uint32_t slot;
+  vector<uint32_t> sensorSlots;
+};
+
+struct FlatRegistry
+{
+  vector<FlatDevice> devices;
+  vector<Sensor> sensors;
+  vector<const string *> sensorNames;
+  FlatIndex deviceIndex;
+  FlatIndex sensorIndex;
+  // 传感器ID到槽位的全局索引
+  FlatIndex globalIndex;
+};
+
+static double seconds(chrono::steady_clock::time_point start)
+{
+  return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char *argv[])
+{
+  int deviceCount = argc > 1 ? atoi(argv[1]) : 10000;
+  int sensorCount = argc > 2 ? atoi(argv[2]) : 10;
+  size_t total = (size_t)deviceCount * sensorCount;
+  string name = "温度";
+  const char *date = "2024-08-12 10:00:00";
+  int64_t timestamp = 1723456800;
+
+  // 随机访问顺序，设备ID和传感器ID与真实数据一样稀疏
+  vector<pair<int, int>> order;
+  order.reserve(total);
+  for (int d = 0; d < deviceCount; d++)
+  {
+    for (int s = 0; s < sensorCount; s++)
+    {
+      order.emplace_back(100000 + d * 7, 5000000 + (d * sensorCount + s) * 3);
+    }
+  }
+  shuffle(order.begin(), order.end(), mt19937(42));
+  size_t before = allocatedBytes;
+
+  // 构建map注册表
+  map<int, MapDevice *> deviceList;
+  for (auto &item : order)
+  {
+    MapDevice *&device = deviceList[item.first];
+    if (device == nullptr)
+    {
+      device = new MapDevice;
+      device->deviceId = item.first;
+    }
+    OldSensor *sensor = new OldSensor;
+    sensor->sensorId = item.second;
+    sensor->sensorName = &name;
+    device->sensorList[item.second] = sensor;
+  }
+  size_t mapBytes = allocatedBytes - before;
+  before = allocatedBytes;
+
+  // 构建连续数组注册表
+  FlatRegistry registry;
+  for (auto &item : order)
+  {
+    uint32_t deviceSlot = registry.deviceIndex.find((uint32_t)item.first);
+    if (deviceSlot == FlatIndex::npos)
+    {
+      deviceSlot = (uint32_t)registry.devices.size();
+      registry.devices.push_back(FlatDevice{item.first, deviceSlot, {}});
+      registry.deviceIndex.insert((uint32_t)item.first, deviceSlot);
+    }
+    uint32_t slot = (uint32_t)registry.sensors.size();
+    registry.sensors.emplace_back();
+    registry.sensors[slot].sensorId = item.second;
+    registry.sensors[slot].deviceSlot = deviceSlot;
+    registry.sensorNames.push_back(&name);
+    registry.devices[deviceSlot].sensorSlots.push_back(slot);
+    registry.sensorIndex.insert((uint64_t)deviceSlot << 32 | (uint32_t)item.second, slot);
+  }
+  size_t flatBytes = allocatedBytes - before;
+  before = allocatedBytes;
+  for (auto &item : order)
+  {
+    registry.globalIndex.insert((uint32_t)item.second, registry.sensorIndex.find(
+        (uint64_t)registry.deviceIndex.find((uint32_t)item.first) << 32 | (uint32_t)item.second));
+  }
+  // 全局索引替换两级索引中的传感器索引
+  size_t globalBytes = flatBytes - registry.sensorIndex.memory() + (allocatedBytes - before);
+
+  // 查找吞吐量
+  long found = 0;
+  auto start = chrono::steady_clock::now();
+  for (auto &item : order)
+  {
+    MapDevice *device = deviceList.find(item.first)->second;
+    found += device->sensorList.find(item.second)->second->sensorId;
+  }
+  double mapLookup = seconds(start);
+
+  start = chrono::steady_clock::now();
+  for (auto &item : order)
+  {
+    uint32_t deviceSlot = registry.deviceIndex.find((uint32_t)item.first);
+    uint32_t slot = registry.sensorIndex.find((uint64_t)deviceSlot << 32 | (uint32_t)item.second);
+    found -= registry.sensors[slot].sensorId;
+  }
+  double flatLookup = seconds(start);
+
+  start = chrono::steady_clock::now();
+  for (auto &item : order)
+  {
+    found += registry.sensors[registry.globalIndex.find((uint32_t)item.second)].sensorId;
+  }
+  double globalLookup = seconds(start);
+
+  // 更新吞吐量，按接口返回的设备顺序遍历并更新时间和状态
+  start = chrono::steady_clock::now();
+  for (auto &item : order)
+  {
+    OldSensor *sensor = deviceList.find(item.first)->second->sensorList.find(item.second)->second;
+    sensor->updateDate.assign(date);
+    sensor->status ^= 1;
+  }
+  double mapUpdate = seconds(start);
+
+  start = chrono::steady_clock::now();
+  for (auto &item : order)
+  {
+    uint32_t deviceSlot = registry.deviceIndex.find((uint32_t)item.first);
+    Sensor &sensor = registry.sensors[registry.sensorIndex.find((uint64_t)deviceSlot << 32 | (uint32_t)item.second)];
+    sensor.updateTs = timestamp;
+    sensor.status ^= 1;
+  }
+  double flatUpdate = seconds(start);
+
+  start = chrono::steady_clock::now();
+  for (auto &item : order)
+  {
+    Sensor &sensor = registry.sensors[registry.globalIndex.find((uint32_t)item.second)];
+    sensor.updateTs = timestamp;
+    sensor.status ^= 1;
+  }
+  double globalUpdate = seconds(start);
+
+  printf("devices=%d sensors_per_device=%d total=%zu check=%ld\n", deviceCount, sensorCount, total, found);
+  printf("%-6s %14s %14s %16s\n", "impl", "lookup_Mops", "update_Mops", "bytes_per_sensor");
+  printf("%-6s %14.2f %14.2f %16.1f\n", "map", total / mapLookup / 1e6, total / mapUpdate / 1e6, (double)mapBytes / total);
+  printf("%-6s %14.2f %14.2f %16.1f\n", "flat", total / flatLookup / 1e6, total / flatUpdate / 1e6, (double)flatBytes / total);
+  printf("%-6s %14.2f %14.2f %16.1f\n", "global", total / globalLookup / 1e6, total / globalUpdate / 1e6, (double)globalBytes / total);
+
+  for (auto &item : deviceList)
+  {
+    for (auto &sensorItem : item.second->sensorList)
+    {
+      delete sensorItem.second;
+    }
+    delete item.second;
+  }
+  return 0;
+}
@@ -0,0 +1,353 @@
+//
+//  steal_bench.cpp
+//
+//  在传感器数差异很大的合成设备页上对比静态分区和工作窃取两种方式并行解码的耗时和负载均衡
+//  每页多数设备只有2个传感器，少数设备有200个，且大设备集中在页首（同一客户的设备ID相邻）；
+//  每台设备的工作与服务端解码阶段相同：校验字段、解析数值和更新时间、查找传感器并按死区过滤
+//
+//  静态分区把一页设备按连续区间平均分给各线程，工作窃取使用include/work_steal.h的线程池，
+//  两者线程数相同；除墙钟时间外统计各线程CPU时间，最大值即该线程数下独占CPU时的完成时间，
+//  最大值与平均值之比表示负载不均衡程度，在CPU数少于线程数的机器上也能反映分区效果
+//
+//  编译: g++ -O2 -std=c++17 -pthread bench/steal_bench.cpp -o steal_bench
+//  运行: ./steal_bench [线程数] [页数] [大设备比例] [大设备传感器数] [是否打乱0/1]
+//  例如: ./steal_bench 4 200 0.1 200 0
+//
+
+#include "../include/flat_index.h"
+#include "../include/work_steal.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using json = nlohmann::json;
+
+static const int PAGE_SIZE = 100;
+
+// 与server.cpp中Sensor相同字段的记录
+struct Sensor
+{
+  int sensorId;
+  uint32_t status;
+  uint8_t valueType;
+  int64_t updateTs;
+  double number;
+};
+
+struct Decoded
+{
+  int sensorId;
+  uint8_t verdict;
+  double number;
+  int64_t updateTs;
+};
+
+static FlatIndex sensorIndex;
+static vector<Sensor> sensors;
+
+static int64_t threadCpuNs()
+{
+  timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int64_t parseDate(const string &date)
+{
+  int y, mon, d, h, min, sec;
+  if (sscanf(date.c_str(), "%d-%d-%d %d:%d:%d", &y, &mon, &d, &h, &min, &sec) != 6)
+  {
+    return -1;
+  }
+  return ((int64_t)(y * 372 + mon * 31 + d)) * 86400 + h * 3600 + min * 60 + sec;
+}
+
+// 解码一台设备，与服务端decodeDeviceData的工作量相当
+static void decodeDevice(json &device, vector<Decoded> &out)
+{
+  if (device["id"] == nullptr || device["sensorsList"] == nullptr || !device["sensorsList"].is_array())
+  {
+    return;
+  }
+  json &list = device["sensorsList"];
+  out.resize(list.size());
+  size_t count = 0;
+  for (json &sensor : list)
+  {
+    if (sensor["id"] == nullptr || sensor["sensorName"] == nullptr || sensor["isLine"] == nullptr ||
+        sensor["updateDate"] == nullptr || sensor["sensorTypeId"] == nullptr || sensor["value"] == nullptr ||
+        sensor["decimalPlacse"] == nullptr)
+    {
+      continue;
+    }
+    string value = sensor["value"];
+    string decimals = sensor["decimalPlacse"];
+    Decoded &item = out[count];
+    item.sensorId = sensor["id"];
+    item.number = stoi(decimals) > 0 ? stof(value) : stoi(value);
+    item.updateTs = parseDate(sensor["updateDate"]);
+    uint32_t slot = sensorIndex.find((uint32_t)item.sensorId);
+    const Sensor *last = slot == FlatIndex::npos ? nullptr : &sensors[slot];
+    item.verdict = last == nullptr ? 2 : last->updateTs == item.updateTs ? 0 : fabs(last->number - item.number) <= 0.5 ? 1 : 2;
+    count++;
+  }
+  out.resize(count);
+}
+
+// 生成偏斜的设备页，大设备集中在页首或随机分布
+static vector<json> makePages(int pages, double bigRate, int bigSensors, bool shuffle)
+{
+  mt19937 rng(7);
+  vector<json> result;
+  int sensorId = 5000000;
+  int deviceId = 100000;
+  for (int p = 0; p < pages; p++)
+  {
+    int bigCount = (int)lround(PAGE_SIZE * bigRate);
+    vector<int> counts(PAGE_SIZE, 2);
+    for (int i = 0; i < bigCount; i++)
+    {
+      counts[i] = bigSensors;
+    }
+    if (shuffle)
+    {
+      std::shuffle(counts.begin(), counts.end(), rng);
+    }
+    json dataList = json::array();
+    for (int count : counts)
+    {
+      json list = json::array();
+      for (int s = 0; s < count; s++)
+      {
+        list.push_back({{"id", sensorId}, {"sensorName", "压力"}, {"isLine", 1}, {"sensorTypeId", 1},
+                        {"updateDate", "2024-08-12 10:00:" + to_string(10 + s % 50)}, {"decimalPlacse", "2"},
+                        {"value", to_string(sensorId % 1000) + ".25"}});
+        sensorIndex.insert((uint32_t)sensorId, (uint32_t)sensors.size());
+        sensors.push_back(Sensor{sensorId, 0, 1, 0, 0});
+        sensorId += 3;
+      }
+      dataList.push_back({{"id", deviceId}, {"deviceName", "4G压力表"}, {"deviceNo", "SIM"}, {"sensorsList", list}});
+      deviceId += 7;
+    }
+    result.push_back(dataList);
+  }
+  return result;
+}
+
+struct Result
+{
+  double wallMs = 0;
+  double cpuMs = 0;
+  double maxThreadMs = 0;
+  double imbalance = 0;
+};
+
+// 各线程累计的解码CPU时间
+struct ThreadTimes
+{
+  vector<atomic<int64_t>> slots;
+  mutex lock;
+  vector<thread::id> owners;
+
+  explicit ThreadTimes(int threads) : slots(threads)
+  {
+  }
+
+  // 当前线程的槽位，按首次出现的顺序分配
+  int slot()
+  {
+    lock_guard<mutex> guard(lock);
+    thread::id self = this_thread::get_id();
+    auto iter = find(owners.begin(), owners.end(), self);
+    if (iter != owners.end())
+    {
+      return (int)(iter - owners.begin());
+    }
+    owners.push_back(self);
+    return (int)owners.size() - 1;
+  }
+
+  Result finish(double wallMs)
+  {
+    Result result;
+    result.wallMs = wallMs;
+    int64_t total = 0;
+    int64_t peak = 0;
+    for (auto &item : slots)
+    {
+      total += item.load();
+      peak = max(peak, item.load());
+    }
+    result.cpuMs = total / 1e6;
+    result.maxThreadMs = peak / 1e6;
+    result.imbalance = total > 0 ? (double)peak * slots.size() / total : 0;
+    return result;
+  }
+};
+
+static void timedDecode(ThreadTimes &times, int slot, json &device, vector<Decoded> &out)
+{
+  int64_t start = threadCpuNs();
+  decodeDevice(device, out);
+  times.slots[slot] += threadCpuNs() - start;
+}
+
+// 静态分区线程池，线程常驻，每页按连续区间平均分给各线程，不窃取
+struct StaticPool
+{
+  vector<thread> threads;
+  mutex lock;
+  condition_variable wake;
+  uint64_t generation = 0;
+  bool stopping = false;
+  atomic<int> busy{0};
+  function<void(int)> job;
+
+  explicit StaticPool(int workers)
+  {
+    for (int t = 1; t <= workers; t++)
+    {
+      threads.emplace_back([this, t]()
+      {
+        uint64_t seen = 0;
+        for (;;)
+        {
+          {
+            unique_lock<mutex> guard(lock);
+            wake.wait(guard, [&]
+                      { return stopping || generation != seen; });
+            if (stopping)
+            {
+              return;
+            }
+            seen = generation;
+          }
+          job(t);
+          busy--;
+        }
+      });
+    }
+  }
+
+  ~StaticPool()
+  {
+    {
+      lock_guard<mutex> guard(lock);
+      stopping = true;
+    }
+    wake.notify_all();
+    for (thread &t : threads)
+    {
+      t.join();
+    }
+  }
+
+  // 调用线程执行第0个分区，等待其他线程完成各自的分区
+  void run(const function<void(int)> &body)
+  {
+    job = body;
+    busy = (int)threads.size();
+    {
+      lock_guard<mutex> guard(lock);
+      generation++;
+    }
+    wake.notify_all();
+    job(0);
+    while (busy.load() != 0)
+    {
+      this_thread::yield();
+    }
+  }
+};
+
+static Result runSerial(vector<json> pages)
+{
+  ThreadTimes times(1);
+  auto start = chrono::steady_clock::now();
+  vector<vector<Decoded>> decoded(PAGE_SIZE);
+  for (json &page : pages)
+  {
+    for (size_t i = 0; i < page.size(); i++)
+    {
+      timedDecode(times, 0, page[i], decoded[i]);
+    }
+  }
+  return times.finish(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+}
+
+// 静态分区，每页按连续区间平均分给各线程
+static Result runStatic(vector<json> pages, int threads)
+{
+  ThreadTimes times(threads);
+  StaticPool pool(threads - 1);
+  vector<vector<Decoded>> decoded(PAGE_SIZE);
+  auto start = chrono::steady_clock::now();
+  for (json &page : pages)
+  {
+    size_t share = (page.size() + threads - 1) / threads;
+    pool.run([&](int t)
+    {
+      for (size_t i = t * share; i < page.size() && i < (t + 1) * share; i++)
+      {
+        timedDecode(times, t, page[i], decoded[i]);
+      }
+    });
+  }
+  return times.finish(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+}
+
+// 工作窃取，调用线程加threads - 1个工作线程
+static Result runStealing(vector<json> pages, int threads, size_t &steals)
+{
+  ThreadTimes times(threads);
+  WorkStealingPool pool(threads - 1);
+  vector<vector<Decoded>> decoded(PAGE_SIZE);
+  auto start = chrono::steady_clock::now();
+  for (json &page : pages)
+  {
+    pool.forEach(page.size(), [&](size_t i)
+    {
+      timedDecode(times, times.slot(), page[i], decoded[i]);
+    });
+  }
+  steals = pool.steals();
+  return times.finish(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+}
+
+int main(int argc, char *argv[])
+{
+  int threads = argc > 1 ? max(atoi(argv[1]), 1) : 4;
+  int pages = argc > 2 ? atoi(argv[2]) : 200;
+  double bigRate = argc > 3 ? atof(argv[3]) : 0.1;
+  int bigSensors = argc > 4 ? atoi(argv[4]) : 200;
+  bool shuffle = argc > 5 && atoi(argv[5]) != 0;
+
+  vector<json> data = makePages(pages, bigRate, bigSensors, shuffle);
+  printf("threads=%d pages=%d page_size=%d big_rate=%.2f big_sensors=%d shuffle=%d sensors=%zu cpus=%u\n", threads, pages,
+         PAGE_SIZE, bigRate, bigSensors, shuffle, sensors.size(), thread::hardware_concurrency());
+  printf("%-9s %10s %10s %14s %10s\n", "mode", "wall_ms", "cpu_ms", "max_thread_ms", "imbalance");
+  auto report = [](const char *name, const Result &result)
+  {
+    printf("%-9s %10.1f %10.1f %14.1f %10.2f\n", name, result.wallMs, result.cpuMs, result.maxThreadMs, result.imbalance);
+    fflush(stdout);
+  };
+  report("serial", runSerial(data));
+  report("static", runStatic(data, threads));
+  size_t steals = 0;
+  report("stealing", runStealing(data, threads, steals));
+  printf("steals=%zu\n", steals);
+  return 0;
+}
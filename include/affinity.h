@@ -0,0 +1,231 @@
+//
+//  affinity.h
+//
+//  线程CPU绑定和调度优先级，按线程角色把网络循环、拉取和解码线程固定到指定CPU，
+//  避免与边缘设备上的其他进程争抢同一个核心；设置只作用于调用线程
+//
+
+#ifndef OPC_AFFINITY_H
+#define OPC_AFFINITY_H
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#if defined(_WIN16) || defined(_WIN32) || defined(_WIN64)
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+
+// ThreadRole结构体，一个线程角色的CPU集合和优先级
+struct ThreadRole
+{
+  // 允许运行的CPU编号，为空则不限制
+  std::vector<int> cpus;
+  // 是否设置nice值
+  bool setNice = false;
+  // nice值，-20到19，越小优先级越高，负值需要CAP_SYS_NICE权限
+  int nice = 0;
+  // 实时优先级，1到99时使用SCHED_FIFO，0表示普通调度
+  int realtime = 0;
+};
+
+// 解析CPU列表，格式同taskset，如"0-1,3"
+inline bool parseCpuList(const std::string &text, std::vector<int> &cpus)
+{
+  cpus.clear();
+  size_t pos = 0;
+  while (pos < text.size())
+  {
+    size_t end = text.find(',', pos);
+    std::string item = text.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+    const char *begin = item.c_str();
+    char *stop = nullptr;
+    long first = strtol(begin, &stop, 10);
+    long last = first;
+    if (stop == begin)
+    {
+      return false;
+    }
+    if (*stop == '-')
+    {
+      begin = stop + 1;
+      last = strtol(begin, &stop, 10);
+      if (stop == begin)
+      {
+        return false;
+      }
+    }
+    if (*stop != '\0' || first < 0 || last < first || last >= 1024)
+    {
+      return false;
+    }
+    for (int cpu = (int)first; cpu <= (int)last; cpu++)
+    {
+      cpus.push_back(cpu);
+    }
+    if (end == std::string::npos)
+    {
+      break;
+    }
+    pos = end + 1;
+  }
+  return !cpus.empty();
+}
+
+// 格式化CPU列表，连续的编号合并为区间
+inline std::string formatCpuList(const std::vector<int> &cpus)
+{
+  std::string text;
+  for (size_t i = 0; i < cpus.size(); i++)
+  {
+    size_t j = i;
+    while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1)
+    {
+      j++;
+    }
+    text += (text.empty() ? "" : ",") + std::to_string(cpus[i]);
+    if (j > i)
+    {
+      text += "-" + std::to_string(cpus[j]);
+    }
+    i = j;
+  }
+  return text.empty() ? "-" : text;
+}
+
+// 当前线程的系统线程ID
+inline long currentThreadId()
+{
+#if defined(_WIN16) || defined(_WIN32) || defined(_WIN64)
+  return (long)GetCurrentThreadId();
+#elif defined(__linux__)
+  return (long)syscall(SYS_gettid);
+#else
+  return (long)getpid();
+#endif
+}
+
+// 按角色设置当前线程的CPU集合和优先级，失败时返回false并给出原因，已成功的设置保留
+inline bool applyThreadRole(const ThreadRole &role, std::string &error)
+{
+  bool ok = true;
+#if defined(__linux__)
+  if (!role.cpus.empty())
+  {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : role.cpus)
+    {
+      CPU_SET(cpu, &set);
+    }
+    if (sched_setaffinity(0, sizeof(set), &set) != 0)
+    {
+      error += std::string("绑定CPU失败: ") + strerror(errno) + "; ";
+      ok = false;
+    }
+  }
+  // Linux的nice值按线程生效
+  if (role.setNice && setpriority(PRIO_PROCESS, (id_t)currentThreadId(), role.nice) != 0)
+  {
+    error += std::string("设置nice失败: ") + strerror(errno) + "; ";
+    ok = false;
+  }
+  if (role.realtime > 0)
+  {
+    sched_param param = {};
+    param.sched_priority = role.realtime;
+    int code = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (code != 0)
+    {
+      error += std::string("设置实时优先级失败: ") + strerror(code) + "; ";
+      ok = false;
+    }
+  }
+#elif defined(_WIN16) || defined(_WIN32) || defined(_WIN64)
+  if (!role.cpus.empty())
+  {
+    DWORD_PTR mask = 0;
+    for (int cpu : role.cpus)
+    {
+      if (cpu < (int)(sizeof(mask) * 8))
+      {
+        mask |= (DWORD_PTR)1 << cpu;
+      }
+    }
+    if (SetThreadAffinityMask(GetCurrentThread(), mask) == 0)
+    {
+      error += "绑定CPU失败: " + std::to_string(GetLastError()) + "; ";
+      ok = false;
+    }
+  }
+  // Windows没有nice值，实时优先级和nice值映射为相近的线程优先级
+  if (role.realtime > 0 || role.setNice)
+  {
+    int priority = role.realtime > 0 ? THREAD_PRIORITY_TIME_CRITICAL
+                   : role.nice <= -10 ? THREAD_PRIORITY_HIGHEST
+                   : role.nice < 0    ? THREAD_PRIORITY_ABOVE_NORMAL
+                   : role.nice == 0   ? THREAD_PRIORITY_NORMAL
+                   : role.nice < 10   ? THREAD_PRIORITY_BELOW_NORMAL
+                                      : THREAD_PRIORITY_LOWEST;
+    if (!SetThreadPriority(GetCurrentThread(), priority))
+    {
+      error += "设置优先级失败: " + std::to_string(GetLastError()) + "; ";
+      ok = false;
+    }
+  }
+#else
+  if (!role.cpus.empty() || role.setNice || role.realtime > 0)
+  {
+    error = "当前平台不支持线程绑定";
+    ok = false;
+  }
+#endif
+  return ok;
+}
+
+// 描述当前线程实际生效的CPU集合和调度设置
+inline std::string describeThread()
+{
+  std::string text = "tid=" + std::to_string(currentThreadId());
+#if defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  std::vector<int> cpus;
+  if (sched_getaffinity(0, sizeof(set), &set) == 0)
+  {
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+    {
+      if (CPU_ISSET(cpu, &set))
+      {
+        cpus.push_back(cpu);
+      }
+    }
+  }
+  int policy = 0;
+  sched_param param = {};
+  pthread_getschedparam(pthread_self(), &policy, &param);
+  errno = 0;
+  int nice = getpriority(PRIO_PROCESS, (id_t)currentThreadId());
+  text += " cpus=" + formatCpuList(cpus) + " nice=" + std::to_string(nice) +
+          " policy=" + (policy == SCHED_FIFO ? "fifo" : policy == SCHED_RR ? "rr" : "other");
+  if (policy == SCHED_FIFO || policy == SCHED_RR)
+  {
+    text += " rtprio=" + std::to_string(param.sched_priority);
+  }
+#elif defined(_WIN16) || defined(_WIN32) || defined(_WIN64)
+  text += " priority=" + std::to_string(GetThreadPriority(GetCurrentThread()));
+#endif
+  return text;
+}
+
+#endif
@@ -0,0 +1,818 @@
+//
+//  async_http.h
+//
+//  基于epoll的非阻塞HTTP/1.1客户端，支持HTTPS、保持连接和分块传输编码
+//  连接注册到调用方的epoll实例，由调用方的事件循环分发事件和处理超时，所有回调在事件循环线程执行
+//  域名在初始化时解析并缓存，连接失败后在后台线程重新解析，事件循环线程不做阻塞的域名解析
+//
+
+#ifndef OPC_ASYNC_HTTP_H
+#define OPC_ASYNC_HTTP_H
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
+// AsyncHttp结构体，同一主机的请求复用连接，超过最大连接数的请求排队
+struct AsyncHttp
+{
+  // 请求结果，status为0表示网络错误或超时，错误信息在error中
+  struct Response
+  {
+    int status = 0;
+    std::string body;
+    std::string error;
+  };
+  typedef std::function<void(const Response &)> Callback;
+  typedef std::vector<std::pair<std::string, std::string>> Headers;
+
+  AsyncHttp() = default;
+  AsyncHttp(const AsyncHttp &) = delete;
+  AsyncHttp &operator=(const AsyncHttp &) = delete;
+
+  ~AsyncHttp()
+  {
+    for (auto &conn : connections)
+    {
+      closeConnection(*conn);
+    }
+    if (resolver.joinable())
+    {
+      resolver.join();
+    }
+    if (address != nullptr)
+    {
+      freeaddrinfo(address);
+    }
+    if (resolved != nullptr)
+    {
+      freeaddrinfo(resolved);
+    }
+    if (sslCtx != nullptr)
+    {
+      SSL_CTX_free(sslCtx);
+    }
+  }
+
+  // 初始化，url格式为http(s)://host[:port]，一个epoll实例只能注册一个AsyncHttp
+  bool init(int epoll, const std::string &url, int timeoutMs, size_t maxConn = 4)
+  {
+    epollFd = epoll;
+    timeout = timeoutMs;
+    maxConnections = maxConn;
+    size_t pos = url.find("://");
+    if (pos == std::string::npos)
+    {
+      return false;
+    }
+    std::string scheme = url.substr(0, pos);
+    if (scheme != "http" && scheme != "https")
+    {
+      return false;
+    }
+    tls = scheme == "https";
+    host = url.substr(pos + 3);
+    size_t slash = host.find('/');
+    if (slash != std::string::npos)
+    {
+      host.resize(slash);
+    }
+    port = tls ? "443" : "80";
+    size_t colon = host.rfind(':');
+    if (colon != std::string::npos && host.find(']') == std::string::npos)
+    {
+      port = host.substr(colon + 1);
+      host.resize(colon);
+    }
+    hostHeader = (tls && port == "443") || (!tls && port == "80") ? host : host + ":" + port;
+    // 在进入事件循环之前解析，失败时在首次连接时转到后台重新解析
+    address = resolve(host, port);
+    if (tls)
+    {
+      sslCtx = SSL_CTX_new(TLS_client_method());
+      if (sslCtx == nullptr)
+      {
+        return false;
+      }
+      SSL_CTX_set_default_verify_paths(sslCtx);
+      SSL_CTX_set_verify(sslCtx, SSL_VERIFY_PEER, nullptr);
+    }
+    return true;
+  }
+
+  // 发起请求，完成、失败或超时后调用回调
+  void request(const std::string &method, const std::string &path, const Headers &headers,
+               const std::string &body, Callback callback)
+  {
+    std::string data = method + " " + path + " HTTP/1.1\r\nHost: " + hostHeader + "\r\n";
+    for (auto &header : headers)
+    {
+      data += header.first + ": " + header.second + "\r\n";
+    }
+    if (!body.empty() || method == "POST")
+    {
+      data += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+    }
+    data += "Connection: keep-alive\r\n\r\n";
+    data += body;
+    pending.push_back(Pending{std::move(data), std::move(callback)});
+    dispatch();
+  }
+
+  // 处理epoll事件，tag为注册时的epoll_event.data.u64
+  void handle(uint64_t tag, uint32_t events)
+  {
+    size_t index = (size_t)(tag >> 32);
+    if (index >= connections.size())
+    {
+      return;
+    }
+    Connection &conn = *connections[index];
+    // 连接已关闭或已被新连接复用时忽略旧事件
+    if (conn.fd < 0 || conn.generation != (uint32_t)tag)
+    {
+      return;
+    }
+    if (conn.state == IDLE)
+    {
+      // 空闲连接可读说明对端关闭
+      closeConnection(conn);
+      dispatch();
+      return;
+    }
+    if ((events & (EPOLLERR | EPOLLHUP)) && conn.state == CONNECTING)
+    {
+      fail(conn, "连接失败");
+      return;
+    }
+    drive(conn);
+  }
+
+  // 处理超时的请求，返回距最近一次超时的毫秒数，没有请求时返回-1
+  int expire()
+  {
+    int64_t now = nowMs();
+    int64_t next = -1;
+    // 回调中可能发起新请求并新增连接，按下标遍历
+    for (size_t i = 0; i < connections.size(); i++)
+    {
+      Connection &conn = *connections[i];
+      if (conn.fd < 0 || conn.state == IDLE)
+      {
+        continue;
+      }
+      if (now >= conn.deadline)
+      {
+        fail(conn, "请求超时", true, false);
+        continue;
+      }
+      if (next < 0 || conn.deadline - now < next)
+      {
+        next = conn.deadline - now;
+      }
+    }
+    return (int)next;
+  }
+
+  // 取消所有进行中和排队的请求，回调收到取消错误
+  void cancelAll()
+  {
+    std::deque<Pending> queued;
+    queued.swap(pending);
+    for (size_t i = 0; i < connections.size(); i++)
+    {
+      Connection &conn = *connections[i];
+      if (conn.fd >= 0 && conn.state != IDLE)
+      {
+        fail(conn, "请求已取消", false, false);
+      }
+    }
+    for (Pending &item : queued)
+    {
+      Response response;
+      response.error = "请求已取消";
+      item.callback(response);
+    }
+  }
+
+  // 进行中和排队的请求数
+  size_t inFlight() const
+  {
+    size_t count = pending.size();
+    for (auto &conn : connections)
+    {
+      count += conn->fd >= 0 && conn->state != IDLE ? 1 : 0;
+    }
+    return count;
+  }
+
+private:
+  enum State
+  {
+    CONNECTING,
+    HANDSHAKE,
+    SENDING,
+    RECEIVING,
+    IDLE
+  };
+
+  struct Pending
+  {
+    std::string data;
+    Callback callback;
+  };
+
+  struct Connection
+  {
+    int fd = -1;
+    uint32_t generation = 0;
+    size_t index = 0;
+    State state = IDLE;
+    // 是否复用了保持的连接
+    bool reused = false;
+    SSL *ssl = nullptr;
+    int64_t deadline = 0;
+    std::string out;
+    size_t written = 0;
+    Callback callback;
+    // 响应解析状态
+    std::string in;
+    size_t headerEnd = 0;
+    int status = 0;
+    bool chunked = false;
+    bool keepAlive = true;
+    long long contentLength = -1;
+    size_t chunkPos = 0;
+    std::string body;
+  };
+
+  int epollFd = -1;
+  int timeout = 30000;
+  size_t maxConnections = 4;
+  bool tls = false;
+  std::string host;
+  std::string port;
+  std::string hostHeader;
+  addrinfo *address = nullptr;
+  // 后台解析线程及其结果，事件循环线程只在打开连接时取走结果
+  std::thread resolver;
+  std::atomic<bool> resolving{false};
+  std::mutex resolvedMutex;
+  addrinfo *resolved = nullptr;
+  SSL_CTX *sslCtx = nullptr;
+  std::vector<std::unique_ptr<Connection>> connections;
+  std::deque<Pending> pending;
+
+  static int64_t nowMs()
+  {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  // 将排队的请求分配给空闲连接或新连接
+  void dispatch()
+  {
+    while (!pending.empty())
+    {
+      Connection *conn = nullptr;
+      for (auto &item : connections)
+      {
+        if (item->fd >= 0 && item->state == IDLE)
+        {
+          conn = item.get();
+          break;
+        }
+      }
+      if (conn == nullptr)
+      {
+        if (openCount() >= maxConnections)
+        {
+          return;
+        }
+        // 打开失败时排队的第一个请求已失败，继续处理其余请求
+        conn = openConnection();
+        if (conn == nullptr)
+        {
+          continue;
+        }
+      }
+      Pending item = std::move(pending.front());
+      pending.pop_front();
+      conn->out = std::move(item.data);
+      conn->written = 0;
+      conn->callback = std::move(item.callback);
+      conn->in.clear();
+      conn->body.clear();
+      conn->headerEnd = 0;
+      conn->status = 0;
+      conn->chunked = false;
+      conn->keepAlive = true;
+      conn->contentLength = -1;
+      conn->chunkPos = 0;
+      conn->deadline = nowMs() + timeout;
+      conn->reused = conn->state == IDLE;
+      if (conn->reused)
+      {
+        conn->state = SENDING;
+        drive(*conn);
+      }
+    }
+  }
+
+  // 已打开的连接数
+  size_t openCount() const
+  {
+    size_t open = 0;
+    for (auto &item : connections)
+    {
+      open += item->fd >= 0 ? 1 : 0;
+    }
+    return open;
+  }
+
+  // 打开新连接，失败时排队的第一个请求失败并返回空
+  Connection *openConnection()
+  {
+    Connection *conn = nullptr;
+    for (auto &item : connections)
+    {
+      if (item->fd < 0)
+      {
+        conn = item.get();
+        break;
+      }
+    }
+    if (conn == nullptr)
+    {
+      connections.emplace_back(new Connection);
+      conn = connections.back().get();
+      conn->index = connections.size() - 1;
+    }
+    adoptResolved();
+    if (address == nullptr)
+    {
+      resolveAsync();
+      failPending("域名解析失败");
+      return nullptr;
+    }
+    conn->fd = socket(address->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (conn->fd < 0)
+    {
+      failPending("创建套接字失败");
+      return nullptr;
+    }
+    int one = 1;
+    setsockopt(conn->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    conn->generation++;
+    conn->state = CONNECTING;
+    if (connect(conn->fd, address->ai_addr, address->ai_addrlen) != 0 && errno != EINPROGRESS)
+    {
+      ::close(conn->fd);
+      conn->fd = -1;
+      // 地址可能已变化，在后台重新解析，解析完成前仍使用原地址
+      resolveAsync();
+      failPending("连接失败");
+      return nullptr;
+    }
+    epoll_event event = {};
+    event.events = EPOLLOUT;
+    event.data.u64 = (uint64_t)conn->index << 32 | conn->generation;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, conn->fd, &event);
+    return conn;
+  }
+
+  // 解析域名，失败时返回空
+  static addrinfo *resolve(const std::string &host, const std::string &port)
+  {
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *result = nullptr;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &result) != 0)
+    {
+      return nullptr;
+    }
+    return result;
+  }
+
+  // 在后台线程重新解析域名，已有解析进行中时忽略
+  void resolveAsync()
+  {
+    if (resolving.exchange(true))
+    {
+      return;
+    }
+    // 上一个解析线程已清除resolving标志，只剩退出
+    if (resolver.joinable())
+    {
+      resolver.join();
+    }
+    resolver = std::thread(&AsyncHttp::resolveBackground, this);
+  }
+
+  // 解析线程入口，解析失败时保留原地址
+  void resolveBackground()
+  {
+    addrinfo *result = resolve(host, port);
+    std::lock_guard<std::mutex> lock(resolvedMutex);
+    if (result != nullptr)
+    {
+      if (resolved != nullptr)
+      {
+        freeaddrinfo(resolved);
+      }
+      resolved = result;
+    }
+    resolving = false;
+  }
+
+  // 取走后台解析的结果替换当前地址
+  void adoptResolved()
+  {
+    std::lock_guard<std::mutex> lock(resolvedMutex);
+    if (resolved != nullptr)
+    {
+      if (address != nullptr)
+      {
+        freeaddrinfo(address);
+      }
+      address = resolved;
+      resolved = nullptr;
+    }
+  }
+
+  // 打开连接失败时排队的第一个请求失败，避免无限重试
+  void failPending(const char *error)
+  {
+    if (pending.empty())
+    {
+      return;
+    }
+    Pending item = std::move(pending.front());
+    pending.pop_front();
+    Response response;
+    response.error = error;
+    item.callback(response);
+  }
+
+  void watch(Connection &conn, uint32_t events)
+  {
+    epoll_event event = {};
+    event.events = events;
+    event.data.u64 = (uint64_t)conn.index << 32 | conn.generation;
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, conn.fd, &event);
+  }
+
+  void closeConnection(Connection &conn)
+  {
+    if (conn.fd < 0)
+    {
+      return;
+    }
+    if (conn.ssl != nullptr)
+    {
+      SSL_free(conn.ssl);
+      conn.ssl = nullptr;
+    }
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, conn.fd, nullptr);
+    ::close(conn.fd);
+    conn.fd = -1;
+    conn.state = IDLE;
+  }
+
+  // 请求失败，关闭连接并回调
+  // 复用的连接可能已被对端关闭，尚未收到任何响应数据时用新连接重试一次
+  void fail(Connection &conn, const char *error, bool next = true, bool retry = true)
+  {
+    Callback callback = std::move(conn.callback);
+    closeConnection(conn);
+    if (retry && conn.reused && conn.in.empty() && callback)
+    {
+      pending.push_front(Pending{std::move(conn.out), std::move(callback)});
+      dispatch();
+      return;
+    }
+    Response response;
+    response.error = error;
+    if (callback)
+    {
+      callback(response);
+    }
+    if (next)
+    {
+      dispatch();
+    }
+  }
+
+  // 按当前状态推进连接，遇到需要等待时设置关注的事件后返回
+  void drive(Connection &conn)
+  {
+    if (conn.state == CONNECTING)
+    {
+      int error = 0;
+      socklen_t length = sizeof(error);
+      if (getsockopt(conn.fd, SOL_SOCKET, SO_ERROR, &error, &length) != 0 || error != 0)
+      {
+        fail(conn, "连接失败");
+        return;
+      }
+      if (tls)
+      {
+        conn.ssl = SSL_new(sslCtx);
+        SSL_set_fd(conn.ssl, conn.fd);
+        SSL_set_mode(conn.ssl, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+        SSL_set_tlsext_host_name(conn.ssl, host.c_str());
+        SSL_set1_host(conn.ssl, host.c_str());
+        conn.state = HANDSHAKE;
+      }
+      else
+      {
+        conn.state = SENDING;
+      }
+    }
+    if (conn.state == HANDSHAKE)
+    {
+      int ret = SSL_connect(conn.ssl);
+      if (ret != 1)
+      {
+        waitSsl(conn, ret, "TLS握手失败");
+        return;
+      }
+      conn.state = SENDING;
+    }
+    if (conn.state == SENDING)
+    {
+      while (conn.written < conn.out.size())
+      {
+        const char *data = conn.out.data() + conn.written;
+        size_t size = conn.out.size() - conn.written;
+        if (conn.ssl != nullptr)
+        {
+          int ret = SSL_write(conn.ssl, data, (int)size);
+          if (ret <= 0)
+          {
+            waitSsl(conn, ret, "发送请求失败");
+            return;
+          }
+          conn.written += (size_t)ret;
+        }
+        else
+        {
+          ssize_t ret = send(conn.fd, data, size, MSG_NOSIGNAL);
+          if (ret < 0)
+          {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+              watch(conn, EPOLLOUT);
+              return;
+            }
+            fail(conn, "发送请求失败");
+            return;
+          }
+          conn.written += (size_t)ret;
+        }
+      }
+      conn.state = RECEIVING;
+      watch(conn, EPOLLIN);
+    }
+    if (conn.state == RECEIVING)
+    {
+      receive(conn);
+    }
+  }
+
+  // 处理SSL读写需要等待的情况
+  void waitSsl(Connection &conn, int ret, const char *error)
+  {
+    int code = SSL_get_error(conn.ssl, ret);
+    if (code == SSL_ERROR_WANT_READ)
+    {
+      watch(conn, EPOLLIN);
+    }
+    else if (code == SSL_ERROR_WANT_WRITE)
+    {
+      watch(conn, EPOLLOUT);
+    }
+    else
+    {
+      ERR_clear_error();
+      fail(conn, error);
+    }
+  }
+
+  // 读取并解析响应
+  void receive(Connection &conn)
+  {
+    char chunk[16384];
+    bool eof = false;
+    for (;;)
+    {
+      if (conn.ssl != nullptr)
+      {
+        int ret = SSL_read(conn.ssl, chunk, sizeof(chunk));
+        if (ret <= 0)
+        {
+          int code = SSL_get_error(conn.ssl, ret);
+          if (code == SSL_ERROR_ZERO_RETURN)
+          {
+            eof = true;
+            break;
+          }
+          if (code == SSL_ERROR_WANT_READ || code == SSL_ERROR_WANT_WRITE)
+          {
+            watch(conn, code == SSL_ERROR_WANT_READ ? EPOLLIN : EPOLLOUT);
+            break;
+          }
+          ERR_clear_error();
+          eof = true;
+          break;
+        }
+        conn.in.append(chunk, (size_t)ret);
+      }
+      else
+      {
+        ssize_t ret = recv(conn.fd, chunk, sizeof(chunk), 0);
+        if (ret == 0)
+        {
+          eof = true;
+          break;
+        }
+        if (ret < 0)
+        {
+          if (errno == EAGAIN || errno == EWOULDBLOCK)
+          {
+            break;
+          }
+          eof = true;
+          break;
+        }
+        conn.in.append(chunk, (size_t)ret);
+      }
+    }
+
+    int done = parse(conn, eof);
+    if (done < 0)
+    {
+      fail(conn, eof ? "连接已关闭" : "响应格式错误");
+      return;
+    }
+    if (done == 0)
+    {
+      if (eof)
+      {
+        fail(conn, "连接已关闭");
+      }
+      return;
+    }
+
+    Response response;
+    response.status = conn.status;
+    response.body = std::move(conn.body);
+    Callback callback = std::move(conn.callback);
+    conn.in.clear();
+    conn.out.clear();
+    if (conn.keepAlive && !eof)
+    {
+      conn.state = IDLE;
+      watch(conn, EPOLLIN);
+    }
+    else
+    {
+      closeConnection(conn);
+    }
+    if (callback)
+    {
+      callback(response);
+    }
+    dispatch();
+  }
+
+  // 解析响应，完成返回1，数据不足返回0，格式错误返回-1
+  int parse(Connection &conn, bool eof)
+  {
+    if (conn.headerEnd == 0)
+    {
+      size_t end = conn.in.find("\r\n\r\n");
+      if (end == std::string::npos)
+      {
+        return conn.in.size() > 65536 ? -1 : 0;
+      }
+      conn.headerEnd = end + 4;
+      size_t lineEnd = conn.in.find("\r\n");
+      std::string statusLine = conn.in.substr(0, lineEnd);
+      if (statusLine.compare(0, 5, "HTTP/") != 0 || statusLine.size() < 12)
+      {
+        return -1;
+      }
+      conn.status = atoi(statusLine.c_str() + 9);
+      conn.keepAlive = statusLine.compare(0, 8, "HTTP/1.0") != 0;
+      size_t pos = lineEnd + 2;
+      while (pos < end)
+      {
+        size_t next = conn.in.find("\r\n", pos);
+        std::string line = conn.in.substr(pos, next - pos);
+        pos = next + 2;
+        size_t colon = line.find(':');
+        if (colon == std::string::npos)
+        {
+          continue;
+        }
+        std::string name = line.substr(0, colon);
+        for (char &c : name)
+        {
+          c = (char)tolower((unsigned char)c);
+        }
+        size_t start = line.find_first_not_of(' ', colon + 1);
+        std::string value = start == std::string::npos ? "" : line.substr(start);
+        for (char &c : value)
+        {
+          c = (char)tolower((unsigned char)c);
+        }
+        if (name == "content-length")
+        {
+          conn.contentLength = atoll(value.c_str());
+        }
+        else if (name == "transfer-encoding" && value.find("chunked") != std::string::npos)
+        {
+          conn.chunked = true;
+        }
+        else if (name == "connection")
+        {
+          conn.keepAlive = value.find("close") == std::string::npos;
+        }
+      }
+      conn.chunkPos = conn.headerEnd;
+      // 没有正文的响应
+      if (conn.status == 204 || conn.status == 304 || (conn.status >= 100 && conn.status < 200))
+      {
+        return 1;
+      }
+    }
+
+    if (conn.chunked)
+    {
+      // 逐块解码，chunkPos指向下一块的长度行
+      for (;;)
+      {
+        size_t lineEnd = conn.in.find("\r\n", conn.chunkPos);
+        if (lineEnd == std::string::npos)
+        {
+          return 0;
+        }
+        size_t size = strtoul(conn.in.c_str() + conn.chunkPos, nullptr, 16);
+        if (size == 0)
+        {
+          // 最后一块之后可能有尾部字段，以空行结束
+          return conn.in.find("\r\n\r\n", lineEnd) == std::string::npos ? 0 : 1;
+        }
+        if (conn.in.size() < lineEnd + 2 + size + 2)
+        {
+          return 0;
+        }
+        conn.body.append(conn.in, lineEnd + 2, size);
+        conn.chunkPos = lineEnd + 2 + size + 2;
+      }
+    }
+    if (conn.contentLength >= 0)
+    {
+      if (conn.in.size() - conn.headerEnd < (size_t)conn.contentLength)
+      {
+        return 0;
+      }
+      conn.body.assign(conn.in, conn.headerEnd, (size_t)conn.contentLength);
+      return 1;
+    }
+    // 没有长度的响应读到连接关闭为止
+    if (eof)
+    {
+      conn.body.assign(conn.in, conn.headerEnd, std::string::npos);
+      conn.keepAlive = false;
+      return 1;
+    }
+    return 0;
+  }
+};
+
+#endif
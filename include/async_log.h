@@ -0,0 +1,307 @@
+//
+//  async_log.h
+//
+//  异步日志器，实现UA_Logger接口；调用线程只按级别过滤、格式化消息并放入无锁环形缓冲区，
+//  由后台写线程批量写到标准输出，终端或管道写入缓慢时不阻塞服务器网络循环和拉取线程
+//  缓冲区为多生产者单消费者的有界队列，写满时丢弃新记录并计数，写线程在下一次写入时输出丢弃条数；
+//  超过单条长度的消息被截断；写线程未运行时（启动前、停止后）直接同步写入，停止时写出所有已放入的记录
+//
+
+#ifndef OPC_ASYNC_LOG_H
+#define OPC_ASYNC_LOG_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <open62541/plugin/log.h>
+
+class AsyncLog
+{
+public:
+  // 单条消息的最大字节数，超出部分截断
+  static const size_t TEXT_SIZE = 480;
+
+  AsyncLog() = default;
+  AsyncLog(const AsyncLog &) = delete;
+  AsyncLog &operator=(const AsyncLog &) = delete;
+
+  ~AsyncLog()
+  {
+    stop();
+  }
+
+  // 分配容量为不小于records的2的幂的缓冲区并启动写线程，低于minLevel的记录直接丢弃
+  void start(size_t records, UA_LogLevel minLevel)
+  {
+    stop();
+    size_t capacity = 2;
+    while (capacity < records)
+    {
+      capacity <<= 1;
+    }
+    slots.reset(new Slot[capacity]);
+    for (size_t i = 0; i < capacity; i++)
+    {
+      slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    mask = capacity - 1;
+    head.store(0, std::memory_order_relaxed);
+    tail = 0;
+    level = minLevel;
+    stopping = false;
+    active.store(true, std::memory_order_release);
+    writer = std::thread(&AsyncLog::writeLoop, this);
+  }
+
+  // 写出缓冲区中剩余的记录并结束写线程
+  void stop()
+  {
+    if (!writer.joinable())
+    {
+      return;
+    }
+    // 之后的记录同步写入，写线程写出已放入的记录后退出
+    active.store(false);
+    {
+      std::lock_guard<std::mutex> guard(wakeLock);
+      stopping = true;
+    }
+    wake.notify_one();
+    writer.join();
+    // 停止前已通过检查的调用线程可能在写线程退出后才放入记录，等其放入后在此写出
+    while (producers.load() != 0)
+    {
+      std::this_thread::yield();
+    }
+    drain();
+  }
+
+  // 等待写线程写出调用前放入的记录，最多等待timeoutMs毫秒，用于强制退出前
+  void flush(int timeoutMs)
+  {
+    if (!active.load(std::memory_order_acquire))
+    {
+      return;
+    }
+    uint64_t target = head.load(std::memory_order_acquire);
+    wakePending.store(true, std::memory_order_relaxed);
+    wake.notify_one();
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (drained.load(std::memory_order_acquire) < target && std::chrono::steady_clock::now() < deadline)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+
+  // 供服务器配置使用的UA_Logger，clear时结束写线程
+  UA_Logger logger()
+  {
+    UA_Logger result;
+    result.log = &AsyncLog::logCallback;
+    result.context = this;
+    result.clear = &AsyncLog::clearCallback;
+    return result;
+  }
+
+  // 因缓冲区已满丢弃的记录数
+  size_t dropped() const
+  {
+    return droppedCount.load(std::memory_order_relaxed);
+  }
+
+  // 已写出的记录数
+  size_t written() const
+  {
+    return writtenCount.load(std::memory_order_relaxed);
+  }
+
+  // 缓冲区容量
+  size_t capacity() const
+  {
+    return slots ? mask + 1 : 0;
+  }
+
+private:
+  struct Slot
+  {
+    std::atomic<uint64_t> sequence{0};
+    int64_t timeMs;
+    UA_LogLevel level;
+    UA_LogCategory category;
+    char text[TEXT_SIZE];
+  };
+
+  std::unique_ptr<Slot[]> slots;
+  uint64_t mask = 0;
+  alignas(64) std::atomic<uint64_t> head{0};
+  alignas(64) uint64_t tail = 0;
+  std::atomic<uint64_t> drained{0};
+  std::atomic<size_t> droppedCount{0};
+  std::atomic<size_t> writtenCount{0};
+  std::atomic<bool> active{false};
+  // 正在放入记录的调用线程数
+  std::atomic<int> producers{0};
+  std::atomic<bool> wakePending{false};
+  UA_LogLevel level = UA_LOGLEVEL_INFO;
+  std::thread writer;
+  std::mutex wakeLock;
+  std::condition_variable wake;
+  bool stopping = false;
+
+  static int64_t nowMs()
+  {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch())
+        .count();
+  }
+
+  static void logCallback(void *context, UA_LogLevel level, UA_LogCategory category, const char *msg, va_list args)
+  {
+    static_cast<AsyncLog *>(context)->push(level, category, msg, args);
+  }
+
+  static void clearCallback(void *context)
+  {
+    static_cast<AsyncLog *>(context)->stop();
+  }
+
+  void push(UA_LogLevel recordLevel, UA_LogCategory category, const char *msg, va_list args)
+  {
+    if (recordLevel < level)
+    {
+      return;
+    }
+    // 先登记再检查写线程状态，与stop的顺序相反，停止时要么同步写入，要么被stop等待并写出
+    producers.fetch_add(1);
+    if (!active.load())
+    {
+      producers.fetch_sub(1, std::memory_order_release);
+      char text[TEXT_SIZE];
+      vsnprintf(text, sizeof(text), msg, args);
+      writeLine(stdout, nowMs(), recordLevel, category, text);
+      fflush(stdout);
+      return;
+    }
+    // 抢占一个空闲槽位，槽位序号等于位置时可写，小于位置说明缓冲区已满
+    uint64_t pos = head.load(std::memory_order_relaxed);
+    Slot *slot;
+    for (;;)
+    {
+      slot = &slots[pos & mask];
+      uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+      int64_t diff = (int64_t)(sequence - pos);
+      if (diff == 0)
+      {
+        if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+        {
+          break;
+        }
+      }
+      else if (diff < 0)
+      {
+        droppedCount.fetch_add(1, std::memory_order_relaxed);
+        producers.fetch_sub(1, std::memory_order_release);
+        return;
+      }
+      else
+      {
+        pos = head.load(std::memory_order_relaxed);
+      }
+    }
+    slot->timeMs = nowMs();
+    slot->level = recordLevel;
+    slot->category = category;
+    vsnprintf(slot->text, TEXT_SIZE, msg, args);
+    slot->sequence.store(pos + 1, std::memory_order_release);
+    // 缓冲区过半时提前唤醒写线程，其余情况由写线程定时醒来批量写出
+    if (pos - drained.load(std::memory_order_relaxed) > mask / 2 && !wakePending.exchange(true))
+    {
+      wake.notify_one();
+    }
+    producers.fetch_sub(1, std::memory_order_release);
+  }
+
+  static void writeLine(FILE *out, int64_t timeMs, UA_LogLevel recordLevel, UA_LogCategory category, const char *text)
+  {
+    static const char *levels[] = {"trace", "debug", "info", "warn", "error", "fatal"};
+    static const char *categories[] = {"network", "channel", "session", "server", "client", "userland", "securitypolicy"};
+    // UA_LogLevel在1.3及以前为0到5，1.4起为100到600
+    int levelIndex = (int)recordLevel < 100 ? (int)recordLevel : (int)recordLevel / 100 - 1;
+    const char *levelName = levelIndex >= 0 && levelIndex < 6 ? levels[levelIndex] : "log";
+    const char *categoryName = (int)category >= 0 && (int)category < 7 ? categories[category] : "other";
+    time_t seconds = (time_t)(timeMs / 1000);
+    struct tm local;
+#if defined(_WIN16) || defined(_WIN32) || defined(_WIN64)
+    localtime_s(&local, &seconds);
+#else
+    localtime_r(&seconds, &local);
+#endif
+    char date[32];
+    strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", &local);
+    fprintf(out, "[%s.%03d] %s/%s\t%s\n", date, (int)(timeMs % 1000), levelName, categoryName, text);
+  }
+
+  // 写出所有已就绪的记录，返回写出的条数
+  size_t drain()
+  {
+    size_t count = 0;
+    for (;;)
+    {
+      Slot &slot = slots[tail & mask];
+      if (slot.sequence.load(std::memory_order_acquire) != tail + 1)
+      {
+        break;
+      }
+      writeLine(stdout, slot.timeMs, slot.level, slot.category, slot.text);
+      slot.sequence.store(tail + mask + 1, std::memory_order_release);
+      tail++;
+      count++;
+    }
+    if (count > 0)
+    {
+      fflush(stdout);
+      writtenCount.fetch_add(count, std::memory_order_relaxed);
+      drained.store(tail, std::memory_order_release);
+    }
+    return count;
+  }
+
+  void writeLoop()
+  {
+    size_t reported = 0;
+    for (;;)
+    {
+      bool last;
+      {
+        std::unique_lock<std::mutex> guard(wakeLock);
+        wake.wait_for(guard, std::chrono::milliseconds(20), [this]
+                      { return stopping || wakePending.load(std::memory_order_relaxed); });
+        last = stopping;
+      }
+      wakePending.store(false, std::memory_order_relaxed);
+      drain();
+      size_t lost = droppedCount.load(std::memory_order_relaxed);
+      if (lost != reported)
+      {
+        char text[128];
+        snprintf(text, sizeof(text), "日志溢出|缓冲区已满，丢弃%zu条，累计%zu条", lost - reported, lost);
+        writeLine(stdout, nowMs(), UA_LOGLEVEL_WARNING, UA_LOGCATEGORY_SERVER, text);
+        fflush(stdout);
+        reported = lost;
+      }
+      if (last)
+      {
+        return;
+      }
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,111 @@
+//
+//  circuit_breaker.h
+//
+//  上游接口的熔断器，连续失败达到阈值后打开，打开期间直接拒绝请求，不再向故障中的接口发请求；
+//  打开一段时间后进入半开状态，只放行一个探测请求，成功则关闭，失败则重新打开
+//  状态转换在锁内进行，状态和累计次数另存为原子变量，指标采集等只读访问不加锁
+//
+
+#ifndef OPC_CIRCUIT_BREAKER_H
+#define OPC_CIRCUIT_BREAKER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+class CircuitBreaker
+{
+public:
+  enum State
+  {
+    CLOSED,
+    OPEN,
+    HALF_OPEN,
+  };
+
+  // 设置打开所需的连续失败次数和打开后进入半开状态的毫秒数
+  void configure(int failureThreshold, int64_t openDurationMs)
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    threshold = failureThreshold > 0 ? failureThreshold : 1;
+    openMs = openDurationMs;
+  }
+
+  // 是否允许发出请求，打开期间拒绝，到时后转为半开并只放行一个探测请求
+  bool allow()
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    if (current == OPEN && std::chrono::steady_clock::now() - openedAt >= std::chrono::milliseconds(openMs))
+    {
+      current = HALF_OPEN;
+      probing = false;
+    }
+    if (current == CLOSED || (current == HALF_OPEN && !probing))
+    {
+      probing = current == HALF_OPEN;
+      return true;
+    }
+    rejectedCount++;
+    return false;
+  }
+
+  // 请求成功，关闭熔断器
+  void onSuccess()
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    failures = 0;
+    current = CLOSED;
+    probing = false;
+  }
+
+  // 请求失败，连续失败达到阈值或探测失败时打开
+  void onFailure()
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    failures++;
+    if (current == HALF_OPEN || (current == CLOSED && failures >= threshold))
+    {
+      current = OPEN;
+      openedAt = std::chrono::steady_clock::now();
+      probing = false;
+      openCount++;
+    }
+  }
+
+  State state() const
+  {
+    return current.load(std::memory_order_relaxed);
+  }
+
+  // 累计打开的次数
+  size_t opens() const
+  {
+    return openCount.load(std::memory_order_relaxed);
+  }
+
+  // 累计因打开而拒绝的请求数
+  size_t rejected() const
+  {
+    return rejectedCount.load(std::memory_order_relaxed);
+  }
+
+  static const char *name(State state)
+  {
+    return state == CLOSED ? "closed" : state == OPEN ? "open" : "half-open";
+  }
+
+private:
+  std::mutex lock;
+  std::atomic<State> current{CLOSED};
+  int threshold = 3;
+  int64_t openMs = 30000;
+  int failures = 0;
+  bool probing = false;
+  std::chrono::steady_clock::time_point openedAt;
+  std::atomic<size_t> openCount{0};
+  std::atomic<size_t> rejectedCount{0};
+};
+
+#endif
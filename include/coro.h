@@ -0,0 +1,290 @@
+//
+//  coro.h
+//
+//  C++20协程任务和单线程执行器，用于事件循环中的拉取流程
+//  任务创建后不立即执行，被co_await或交给执行器后才开始；等待I/O时挂起，
+//  I/O回调把协程投递回执行器，由事件循环在处理完本轮事件后恢复
+//
+
+#ifndef OPC_CORO_H
+#define OPC_CORO_H
+
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+template <typename T = void>
+class Task;
+
+namespace coro_detail
+{
+  // 任务承诺的公共部分，结束时恢复等待者，分离的任务结束时自行销毁
+  struct PromiseBase
+  {
+    std::coroutine_handle<> continuation;
+    std::exception_ptr error;
+    bool detached = false;
+    // 分离的任务的异常处理函数
+    void (*onError)(std::exception_ptr) = nullptr;
+
+    struct FinalAwaiter
+    {
+      bool await_ready() noexcept
+      {
+        return false;
+      }
+
+      template <typename P>
+      std::coroutine_handle<> await_suspend(std::coroutine_handle<P> handle) noexcept
+      {
+        PromiseBase &promise = handle.promise();
+        if (promise.detached)
+        {
+          handle.destroy();
+          return std::noop_coroutine();
+        }
+        return promise.continuation ? promise.continuation : std::noop_coroutine();
+      }
+
+      void await_resume() noexcept
+      {
+      }
+    };
+
+    std::suspend_always initial_suspend() noexcept
+    {
+      return {};
+    }
+
+    FinalAwaiter final_suspend() noexcept
+    {
+      return {};
+    }
+
+    // 分离的任务没有等待者，异常交给执行器的异常处理函数后丢弃，不从执行器抛出
+    void unhandled_exception()
+    {
+      if (detached)
+      {
+        if (onError != nullptr)
+        {
+          onError(std::current_exception());
+        }
+        return;
+      }
+      error = std::current_exception();
+    }
+  };
+
+  template <typename T>
+  struct Promise : PromiseBase
+  {
+    std::optional<T> value;
+
+    void return_value(T result)
+    {
+      value = std::move(result);
+    }
+  };
+
+  template <>
+  struct Promise<void> : PromiseBase
+  {
+    void return_void()
+    {
+    }
+  };
+}
+
+// 协程任务，co_await时开始执行并在结束后恢复等待者
+template <typename T>
+class Task
+{
+public:
+  struct promise_type : coro_detail::Promise<T>
+  {
+    Task get_return_object()
+    {
+      return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+  };
+
+  Task(Task &&other) noexcept : handle(std::exchange(other.handle, nullptr))
+  {
+  }
+
+  Task(const Task &) = delete;
+  Task &operator=(const Task &) = delete;
+
+  ~Task()
+  {
+    if (handle)
+    {
+      handle.destroy();
+    }
+  }
+
+  bool await_ready() const noexcept
+  {
+    return false;
+  }
+
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+  {
+    handle.promise().continuation = awaiting;
+    return handle;
+  }
+
+  T await_resume()
+  {
+    if (handle.promise().error)
+    {
+      std::rethrow_exception(handle.promise().error);
+    }
+    if constexpr (!std::is_void_v<T>)
+    {
+      return std::move(*handle.promise().value);
+    }
+  }
+
+  // 转为分离的任务，返回待恢复的句柄，任务结束后自行销毁，未捕获的异常交给onError
+  std::coroutine_handle<> detach(void (*onError)(std::exception_ptr) = nullptr)
+  {
+    handle.promise().detached = true;
+    handle.promise().onError = onError;
+    return std::exchange(handle, nullptr);
+  }
+
+private:
+  explicit Task(std::coroutine_handle<promise_type> coroutine) : handle(coroutine)
+  {
+  }
+
+  std::coroutine_handle<promise_type> handle;
+};
+
+// 单线程执行器，保存就绪的协程，由事件循环调用run恢复
+class Executor
+{
+public:
+  // 投递就绪的协程
+  void post(std::coroutine_handle<> handle)
+  {
+    ready.push_back(handle);
+  }
+
+  // 设置分离任务的异常处理函数，未设置时异常被丢弃
+  void setErrorHandler(void (*handler)(std::exception_ptr))
+  {
+    onError = handler;
+  }
+
+  // 分离启动任务，下一次run时开始执行
+  template <typename T>
+  void spawn(Task<T> task)
+  {
+    post(task.detach(onError));
+  }
+
+  // 让出执行，当前协程排到就绪队列末尾，用于在各阶段之间交接
+  auto schedule()
+  {
+    struct Awaiter
+    {
+      Executor &executor;
+
+      bool await_ready() const noexcept
+      {
+        return false;
+      }
+
+      void await_suspend(std::coroutine_handle<> handle)
+      {
+        executor.post(handle);
+      }
+
+      void await_resume() const noexcept
+      {
+      }
+    };
+    return Awaiter{*this};
+  }
+
+  // 恢复本次调用前已就绪的协程，期间新就绪的留到下一次，返回恢复的数量
+  size_t run()
+  {
+    size_t count = ready.size();
+    for (size_t i = 0; i < count; i++)
+    {
+      std::coroutine_handle<> handle = ready.front();
+      ready.pop_front();
+      handle.resume();
+    }
+    return count;
+  }
+
+  bool empty() const
+  {
+    return ready.empty();
+  }
+
+private:
+  std::deque<std::coroutine_handle<>> ready;
+  void (*onError)(std::exception_ptr) = nullptr;
+};
+
+// 等待一组分离任务全部结束，最后一个结束时把等待者投递回执行器
+class WaitGroup
+{
+public:
+  explicit WaitGroup(Executor &owner) : executor(owner)
+  {
+  }
+
+  void add(size_t n = 1)
+  {
+    count += n;
+  }
+
+  void done()
+  {
+    if (--count == 0 && waiter)
+    {
+      executor.post(std::exchange(waiter, nullptr));
+    }
+  }
+
+  auto wait()
+  {
+    struct Awaiter
+    {
+      WaitGroup &group;
+
+      bool await_ready() const noexcept
+      {
+        return group.count == 0;
+      }
+
+      void await_suspend(std::coroutine_handle<> handle)
+      {
+        group.waiter = handle;
+      }
+
+      void await_resume() const noexcept
+      {
+      }
+    };
+    return Awaiter{*this};
+  }
+
+private:
+  Executor &executor;
+  size_t count = 0;
+  std::coroutine_handle<> waiter;
+};
+
+#endif
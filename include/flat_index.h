@@ -0,0 +1,134 @@
+//
+//  flat_index.h
+//
+//  开放寻址哈希索引，将64位整数键映射到连续数组中的槽位下标
+//
+
+#ifndef OPC_FLAT_INDEX_H
+#define OPC_FLAT_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// FlatIndex结构体，线性探测，负载超过一半时扩容
+struct FlatIndex
+{
+  // 未找到时返回的槽位
+  static const uint32_t npos = UINT32_MAX;
+
+  // 查找键对应的槽位
+  uint32_t find(uint64_t key) const
+  {
+    if (entries.empty())
+    {
+      return npos;
+    }
+    for (size_t i = hash(key) & mask;; i = (i + 1) & mask)
+    {
+      const Entry &entry = entries[i];
+      if (entry.slot == npos)
+      {
+        return npos;
+      }
+      if (entry.key == key)
+      {
+        return entry.slot;
+      }
+    }
+  }
+
+  // 插入或覆盖键对应的槽位
+  void insert(uint64_t key, uint32_t slot)
+  {
+    if ((count + 1) * 2 > entries.size())
+    {
+      grow();
+    }
+    if (place(key, slot))
+    {
+      count++;
+    }
+  }
+
+  // 清空索引
+  void clear()
+  {
+    entries.clear();
+    count = 0;
+    mask = 0;
+  }
+
+  // 键的数量
+  size_t size() const
+  {
+    return count;
+  }
+
+  // 占用的内存字节数
+  size_t memory() const
+  {
+    return entries.capacity() * sizeof(Entry);
+  }
+
+private:
+  struct Entry
+  {
+    uint64_t key;
+    uint32_t slot;
+  };
+
+  std::vector<Entry> entries;
+  size_t count = 0;
+  size_t mask = 0;
+
+  // splitmix64混合，避免连续ID聚集
+  static size_t hash(uint64_t key)
+  {
+    key ^= key >> 30;
+    key *= 0xbf58476d1ce4e5b9ULL;
+    key ^= key >> 27;
+    key *= 0x94d049bb133111ebULL;
+    key ^= key >> 31;
+    return (size_t)key;
+  }
+
+  // 放入键值，新键返回true
+  bool place(uint64_t key, uint32_t slot)
+  {
+    for (size_t i = hash(key) & mask;; i = (i + 1) & mask)
+    {
+      Entry &entry = entries[i];
+      if (entry.slot == npos)
+      {
+        entry.key = key;
+        entry.slot = slot;
+        return true;
+      }
+      if (entry.key == key)
+      {
+        entry.slot = slot;
+        return false;
+      }
+    }
+  }
+
+  // 容量翻倍并重新放入所有键
+  void grow()
+  {
+    std::vector<Entry> old;
+    old.swap(entries);
+    size_t capacity = old.empty() ? 16 : old.size() * 2;
+    entries.assign(capacity, Entry{0, npos});
+    mask = capacity - 1;
+    for (const Entry &entry : old)
+    {
+      if (entry.slot != npos)
+      {
+        place(entry.key, entry.slot);
+      }
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,991 @@
+//
+//  ingest.h
+//
+//  拉取数据的解码和应用：服务器配置、设备和传感器注册表、传感器数值的解码、过滤和提交，
+//  以及OPC设备对象和传感器变量的创建和写入；全局状态为inline变量，服务端和基准测试共用同一份实现
+//  调用前须设置opcServer、serverCfg和各命名空间索引，只在拉取线程调用
+//
+
+#ifndef OPC_INGEST_H
+#define OPC_INGEST_H
+
+#include "flat_index.h"
+#include "journal.h"
+#include "affinity.h"
+#include "log.h"
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include <open62541/server.h>
+
+// Deadband结构体
+struct Deadband
+{
+  // 绝对死区
+  double abs = 0;
+  // 百分比死区，相对上次写入值
+  double pct = 0;
+};
+
+// Config结构体
+struct Config
+{
+  std::string username;
+  std::string password;
+  std::string clientId;
+  std::string secret;
+  int userId;
+  // 懒加载传感器节点
+  bool lazyNodes = false;
+  // 懒加载节点空闲回收秒数，0表示不回收
+  int lazyIdleSec = 600;
+  // 按传感器类型ID配置的死区
+  std::map<int, Deadband> deadbands;
+  // 注册表快照文件，为空则不使用快照
+  std::string snapshotFile;
+  // 变更日志文件，为空则不使用日志
+  std::string journalFile;
+  // 变更日志超过该字节数时合并到快照
+  size_t journalCompactBytes = 64 * 1024 * 1024;
+  // 上游时间相对UTC的偏移分钟数，默认北京时间
+  int utcOffset = 480;
+  // 多线程模式下拉取线程每写入多少个变量让出一次服务器锁
+  int applyChunk = 256;
+  // 事件循环模式，仅Linux且以C++20编译
+  bool eventLoop = false;
+  // 事件循环模式下有请求进行中时的最长等待毫秒数
+  int loopTickMs = 2;
+  // 上游请求的连接和读写超时毫秒数
+  int httpTimeoutMs = 30000;
+  // 事件循环模式下同时获取的页数
+  int fetchConcurrency = 4;
+  // 解码线程数，0表示在拉取线程解码
+  int decodeWorkers = 0;
+  // 收到停止信号后的退出期限毫秒数，超过期限强制退出
+  int shutdownTimeoutMs = 4000;
+  // 在token有效期的该比例处后台刷新
+  double tokenRefreshFraction = 0.8;
+  // 刷新时间的随机抖动，有效期的比例
+  double tokenRefreshJitter = 0.05;
+  // token状态文件，重启后直接使用未失效的token，为空则不保存
+  std::string tokenFile;
+  // 按线程角色配置的CPU集合和优先级，角色为network、ingest、decode
+  std::map<std::string, ThreadRole> threadRoles;
+  // 上游请求失败后的最多重试次数
+  int retryMax = 2;
+  // 重试等待的基数和上限毫秒数，每次重试基数翻倍，实际等待在0到该值之间随机
+  int retryBaseMs = 200;
+  int retryMaxMs = 5000;
+  // 熔断器打开所需的连续失败请求数
+  int breakerFailures = 3;
+  // 熔断器打开后进入半开状态的毫秒数
+  int breakerOpenMs = 30000;
+  // 日志由后台线程异步写出，调用线程不等待终端或管道
+  bool asyncLog = true;
+  // 异步日志缓冲区的记录数，写满时丢弃新记录
+  int logBufferRecords = 4096;
+  // 运行指标HTTP端口，0表示不开启
+  int metricsPort = 0;
+  // 运行指标监听地址
+  std::string metricsHost = "0.0.0.0";
+};
+
+// 声明配置变量
+inline Config cfg;
+
+// 声明并初始化服务器配置
+inline UA_ServerConfig *serverCfg = nullptr;
+
+// 声明并初始化服务器对象
+inline UA_Server *opcServer = nullptr;
+
+// 声明传感器空间索引
+inline UA_UInt16 sensorNsIndex;
+
+// 更新变量值，数值、状态和源时间戳一次写入
+inline void updateVariable(int sensorId, UA_StatusCode status, UA_DateTime sourceTs, UA_Variant value)
+{
+  // 声明并初始化写入值
+  UA_WriteValue wv;
+  UA_WriteValue_init(&wv);
+
+  // 设定写入值的节点ID和属性类型
+  wv.nodeId = UA_NODEID_NUMERIC(sensorNsIndex, sensorId);
+  wv.attributeId = UA_ATTRIBUTEID_VALUE;
+
+  // 写入变量的数值、状态和源时间戳
+  wv.value.value = value;
+  wv.value.hasValue = true;
+  wv.value.status = status;
+  wv.value.hasStatus = true;
+  wv.value.sourceTimestamp = sourceTs;
+  wv.value.hasSourceTimestamp = true;
+  auto rv = UA_Server_write(opcServer, &wv);
+  OPC_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, rv == UA_STATUSCODE_GOOD ? "写入数值成功" : "写入数值失败");
+}
+
+// 声明设备空间索引
+inline UA_UInt16 deviceNsIndex;
+
+// 创建OPC传感器变量
+inline UA_StatusCode createSensorVariable(int id, int pid, const char *name, const char *desc, UA_Variant value, void *context)
+{
+  UA_VariableAttributes vAttr = UA_VariableAttributes_default;
+  // 添加节点时会深拷贝属性，直接引用名称缓冲区即可
+  vAttr.description = UA_LOCALIZEDTEXT((char *)"zh-CN", (char *)desc);
+  vAttr.displayName = UA_LOCALIZEDTEXT((char *)"zh-CN", (char *)name);
+  vAttr.accessLevel = UA_ACCESSLEVELMASK_READ;
+  vAttr.valueRank = UA_VALUERANK_SCALAR;
+  vAttr.dataType = value.type->typeId;
+  vAttr.value = value;
+
+  UA_StatusCode retval = UA_Server_addVariableNode(
+      opcServer,                                           // server
+      UA_NODEID_NUMERIC(sensorNsIndex, id),                // requestedNewNodeId
+      UA_NODEID_NUMERIC(deviceNsIndex, pid),               // parentNodeId
+      UA_NODEID_NUMERIC(0, UA_NS0ID_HASPROPERTY),          // referenceTypeId
+      UA_QUALIFIEDNAME(sensorNsIndex, (char *)name),       // browseName
+      UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE), // typeDefinition
+      vAttr,                                               // objectAttributes
+      context, NULL);
+
+  OPC_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "%s|创建OPC传感器变量[%s]", UA_StatusCode_name(retval), name);
+
+  return retval;
+}
+
+// StringPool结构体，相同内容的名称共享同一份缓冲区
+struct StringPool
+{
+  std::unordered_set<std::string> strings;
+  // 不驻留时所需的字节数
+  size_t requestedBytes = 0;
+  // 驻留后实际占用的字节数
+  size_t storedBytes = 0;
+
+  // 驻留字符串，返回的指针在程序运行期间一直有效
+  const std::string *intern(const std::string &str)
+  {
+    requestedBytes += str.size() + 1;
+    auto result = strings.insert(str);
+    if (result.second)
+    {
+      storedBytes += str.size() + 1;
+    }
+    return &*result.first;
+  }
+};
+
+// 声明名称常量池
+inline StringPool namePool;
+
+// 传感器数值类型
+enum SensorValueType : uint8_t
+{
+  VALUE_NONE,
+  VALUE_FLOAT,
+  VALUE_INTEGER,
+  VALUE_BOOLEAN,
+  VALUE_STRING,
+};
+
+// Sensor结构体，只保留更新路径用到的热数据，两个记录恰好占满一个64字节缓存行
+struct alignas(32) Sensor
+{
+  int sensorId;
+  // 所属设备在注册表中的槽位
+  uint32_t deviceSlot;
+  UA_StatusCode status;
+  // 传感器类型ID
+  uint8_t typeId;
+  // 最新数值的类型
+  uint8_t valueType;
+  // 是否已创建OPC传感器变量
+  bool materialized;
+  // 更新时间，上游本地时间的秒数
+  int64_t updateTs;
+  // 最新写入的数值，字符串数值保存为字符串表中的句柄
+  union
+  {
+    double number;
+    uint32_t text;
+  } value;
+};
+static_assert(sizeof(Sensor) == 32, "Sensor记录应为32字节");
+
+// SensorMeta结构体，传感器的冷数据，与传感器记录按槽位一一对应
+struct SensorMeta
+{
+  const std::string *sensorName;
+};
+
+// Device结构体
+struct Device
+{
+  int deviceId;
+  // 设备在注册表中的槽位
+  uint32_t slot;
+  std::string deviceNo;
+  const std::string *deviceName;
+  // 传感器在注册表中的槽位
+  std::vector<uint32_t> sensorSlots;
+  // 传感器变量是否已物化
+  bool materialized = true;
+  // 最近一次被客户端访问的单调时间
+  UA_DateTime lastAccess = 0;
+};
+
+// Registry结构体，设备和传感器存放在连续数组中，通过哈希索引按ID查找槽位
+struct Registry
+{
+  std::vector<Device> devices;
+  std::vector<Sensor> sensors;
+  // 传感器冷数据
+  std::vector<SensorMeta> sensorMetas;
+  // 字符串数值表及空闲句柄
+  std::vector<std::string> texts;
+  std::vector<uint32_t> freeTexts;
+  // 设备ID到设备槽位的索引
+  FlatIndex deviceIndex;
+  // 传感器ID到传感器槽位的全局索引，传感器ID全局唯一
+  FlatIndex sensorIndex;
+
+  // 按ID查找设备
+  Device *findDevice(int deviceId)
+  {
+    uint32_t slot = deviceIndex.find((uint32_t)deviceId);
+    return slot == FlatIndex::npos ? nullptr : &devices[slot];
+  }
+
+  // 新建设备，返回的指针在下次新建设备前有效
+  Device *addDevice(int deviceId)
+  {
+    uint32_t slot = (uint32_t)devices.size();
+    devices.emplace_back();
+    devices[slot].deviceId = deviceId;
+    devices[slot].slot = slot;
+    deviceIndex.insert((uint32_t)deviceId, slot);
+    return &devices[slot];
+  }
+
+  // 按ID直接查找传感器，无需经过所属设备
+  Sensor *findSensor(int sensorId)
+  {
+    uint32_t slot = sensorIndex.find((uint32_t)sensorId);
+    return slot == FlatIndex::npos ? nullptr : &sensors[slot];
+  }
+
+  // 新建设备下的传感器，返回的指针在下次新建传感器前有效
+  Sensor *addSensor(Device *device, int sensorId, const std::string *sensorName)
+  {
+    uint32_t slot = (uint32_t)sensors.size();
+    Sensor sensor = {};
+    sensor.sensorId = sensorId;
+    sensor.deviceSlot = device->slot;
+    sensor.status = UA_STATUSCODE_GOOD;
+    sensors.push_back(sensor);
+    sensorMetas.push_back(SensorMeta{sensorName});
+    device->sensorSlots.push_back(slot);
+    sensorIndex.insert((uint32_t)sensorId, slot);
+    return &sensors[slot];
+  }
+
+  // 获取传感器的冷数据
+  SensorMeta &meta(const Sensor *sensor)
+  {
+    return sensorMetas[sensor - sensors.data()];
+  }
+
+  // 分配字符串数值句柄
+  uint32_t allocText()
+  {
+    if (!freeTexts.empty())
+    {
+      uint32_t text = freeTexts.back();
+      freeTexts.pop_back();
+      return text;
+    }
+    texts.emplace_back();
+    return (uint32_t)texts.size() - 1;
+  }
+
+  // 清空注册表
+  void clear()
+  {
+    sensors.clear();
+    sensorMetas.clear();
+    texts.clear();
+    freeTexts.clear();
+    devices.clear();
+    sensorIndex.clear();
+    deviceIndex.clear();
+  }
+};
+
+// 声明设备注册表
+inline Registry registry;
+
+// 声明并初始化注册表变更标志，有变更时周期结束写入快照
+inline bool registryDirty = false;
+
+// 节点上下文保存设备槽位加一，避免数组扩容后指针失效
+inline void *deviceContext(const Device *device)
+{
+  return (void *)(uintptr_t)(device->slot + 1);
+}
+
+// 从节点上下文获取设备
+inline Device *contextDevice(void *context)
+{
+  uintptr_t slot = (uintptr_t)context;
+  return slot == 0 || slot > registry.devices.size() ? nullptr : &registry.devices[slot - 1];
+}
+
+// ValueVariant结构体，由传感器记录生成OPC变量值，数据存放在自身不做堆分配
+struct ValueVariant
+{
+  UA_Variant variant;
+  union
+  {
+    UA_Float f;
+    UA_IntegerId i;
+    UA_Boolean b;
+    UA_String s;
+  };
+
+  ValueVariant(const Sensor *sensor)
+  {
+    UA_Variant_init(&variant);
+    switch (sensor->valueType)
+    {
+    case VALUE_FLOAT:
+      f = (UA_Float)sensor->value.number;
+      UA_Variant_setScalar(&variant, &f, &UA_TYPES[UA_TYPES_FLOAT]);
+      break;
+    case VALUE_INTEGER:
+      i = (UA_IntegerId)sensor->value.number;
+      UA_Variant_setScalar(&variant, &i, &UA_TYPES[UA_TYPES_INTEGERID]);
+      break;
+    case VALUE_BOOLEAN:
+      b = sensor->value.number != 0;
+      UA_Variant_setScalar(&variant, &b, &UA_TYPES[UA_TYPES_BOOLEAN]);
+      break;
+    case VALUE_STRING:
+    {
+      const std::string &text = registry.texts[sensor->value.text];
+      s.length = text.size();
+      s.data = (UA_Byte *)text.data();
+      UA_Variant_setScalar(&variant, &s, &UA_TYPES[UA_TYPES_STRING]);
+      break;
+    }
+    }
+  }
+
+  ValueVariant(const ValueVariant &) = delete;
+  ValueVariant &operator=(const ValueVariant &) = delete;
+};
+
+// 将传感器更新时间转换为OPC源时间戳
+inline UA_DateTime sourceTime(const Sensor *sensor)
+{
+  return (sensor->updateTs - cfg.utcOffset * 60) * UA_DATETIME_SEC + UA_DATETIME_UNIX_EPOCH;
+}
+
+// 上游熔断期间数值不再更新，原为Good状态的变量对外标记为Uncertain_LastUsableValue
+inline bool upstreamStale = false;
+
+// 传感器变量对外的状态，注册表中保留上游给出的状态
+inline UA_StatusCode publishedStatus(const Sensor *sensor)
+{
+  return upstreamStale && sensor->status == UA_STATUSCODE_GOOD ? UA_STATUSCODE_UNCERTAINLASTUSABLEVALUE : sensor->status;
+}
+
+// 为传感器创建OPC传感器变量
+inline UA_StatusCode materializeSensor(Sensor *sensor)
+{
+  Device *device = &registry.devices[sensor->deviceSlot];
+  const char *name = registry.meta(sensor).sensorName->c_str();
+  ValueVariant value(sensor);
+  UA_StatusCode retval = createSensorVariable(
+      sensor->sensorId, device->deviceId, name, name, value.variant, deviceContext(device));
+  if (retval != UA_STATUSCODE_GOOD)
+  {
+    return retval;
+  }
+  sensor->materialized = true;
+  // 创建节点时无法设定状态和源时间戳，需要单独写入
+  updateVariable(sensor->sensorId, publishedStatus(sensor), sourceTime(sensor), value.variant);
+  return retval;
+}
+
+// SensorValue结构体，解析上游数据得到的传感器数值
+struct SensorValue
+{
+  uint8_t type = VALUE_NONE;
+  double number = 0;
+  std::string text;
+};
+
+// 解析"YYYY-MM-DD hh:mm:ss"格式的时间为秒数，按上游本地时间计算，失败返回-1
+inline int64_t parseUpdateDate(const std::string &date)
+{
+  int y, mon, d, h, min, sec;
+  if (sscanf(date.c_str(), "%d-%d-%d %d:%d:%d", &y, &mon, &d, &h, &min, &sec) != 6 || mon < 1 || mon > 12)
+  {
+    return -1;
+  }
+  // 公历日期转换为1970-01-01起的天数
+  y -= mon <= 2;
+  int64_t era = (y >= 0 ? y : y - 399) / 400;
+  int64_t yoe = y - era * 400;
+  int64_t doy = (153 * (mon + (mon > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  int64_t days = era * 146097 + doe - 719468;
+  return days * 86400 + h * 3600 + min * 60 + sec;
+}
+
+// JournalRecord结构体，变更日志中的一条传感器数值记录，字符串数值紧随其后
+struct JournalRecord
+{
+  uint32_t slot;
+  int32_t sensorId;
+  UA_StatusCode status;
+  uint32_t textLength;
+  int64_t updateTs;
+  double number;
+  uint8_t valueType;
+  uint8_t reserved[7];
+};
+
+// 声明变更日志
+inline Journal journal;
+
+// 将传感器的最新数值追加到变更日志
+inline void journalSensor(const Sensor *sensor)
+{
+  JournalRecord record = {};
+  record.slot = (uint32_t)(sensor - registry.sensors.data());
+  record.sensorId = sensor->sensorId;
+  record.status = sensor->status;
+  record.updateTs = sensor->updateTs;
+  record.valueType = sensor->valueType;
+  if (sensor->valueType == VALUE_STRING)
+  {
+    const std::string &text = registry.texts[sensor->value.text];
+    record.textLength = (uint32_t)text.size();
+    journal.append(&record, sizeof(record), text.data(), record.textLength);
+  }
+  else
+  {
+    record.number = sensor->value.number;
+    journal.append(&record, sizeof(record));
+  }
+}
+
+// 声明并初始化本周期写入和抑制的次数
+inline size_t writesApplied = 0;
+inline size_t writesSuppressed = 0;
+
+// 判断新数值是否与上次写入值相同或在死区范围内
+inline bool withinDeadband(const Sensor *sensor, const SensorValue &value)
+{
+  // 没有上次写入值或类型变化都需要写入
+  if (sensor->valueType != value.type)
+  {
+    return false;
+  }
+  // 字符串比较内容
+  if (value.type == VALUE_STRING)
+  {
+    return registry.texts[sensor->value.text] == value.text;
+  }
+  // 数值类型按死区比较，开关量要求完全相同
+  double last = sensor->value.number;
+  double diff = fabs(value.number - last);
+  auto iter = cfg.deadbands.find(sensor->typeId);
+  if (iter == cfg.deadbands.end() || value.type == VALUE_BOOLEAN)
+  {
+    return diff == 0;
+  }
+  return diff <= iter->second.abs || diff <= fabs(last) * iter->second.pct / 100;
+}
+
+// 保存传感器最新写入的数值，字符串使用文本句柄
+inline void storeSensorValue(Sensor *sensor, const SensorValue &value)
+{
+  if (value.type == VALUE_STRING)
+  {
+    if (sensor->valueType != VALUE_STRING)
+    {
+      sensor->value.text = registry.allocText();
+    }
+    registry.texts[sensor->value.text] = value.text;
+  }
+  else
+  {
+    if (sensor->valueType == VALUE_STRING)
+    {
+      registry.freeTexts.push_back(sensor->value.text);
+    }
+    sensor->value.number = value.number;
+  }
+  sensor->valueType = value.type;
+}
+
+// 新数值的过滤结果
+enum Verdict : uint8_t
+{
+  // 时间没有变化，不更新
+  VERDICT_UNCHANGED,
+  // 只更新时间，抑制写入
+  VERDICT_SUPPRESS,
+  // 更新并写入
+  VERDICT_WRITE,
+};
+
+// 过滤传感器的新数值，只读取注册表，可在解码线程执行
+inline Verdict filterSensorValue(const Sensor *sensor, UA_StatusCode status, int64_t updateTs, const SensorValue &value)
+{
+  // 时间没有变化则不更新
+  if (sensor->updateTs == updateTs)
+  {
+    return VERDICT_UNCHANGED;
+  }
+  // 状态不变且数值相同或在死区范围内则抑制写入
+  if (sensor->status == status && withinDeadband(sensor, value))
+  {
+    return VERDICT_SUPPRESS;
+  }
+  return VERDICT_WRITE;
+}
+
+// 按过滤结果提交传感器的新数值
+inline void commitSensorValue(Sensor *sensor, Verdict verdict, UA_StatusCode status, int64_t updateTs, const SensorValue &value)
+{
+  if (verdict == VERDICT_UNCHANGED)
+  {
+    return;
+  }
+  sensor->updateTs = updateTs;
+  registryDirty = true;
+  if (verdict == VERDICT_SUPPRESS)
+  {
+    writesSuppressed++;
+    return;
+  }
+  sensor->status = status;
+  storeSensorValue(sensor, value);
+
+  // 记录到变更日志，在每个拉取周期结束时组提交
+  if (journal.isOpen())
+  {
+    journalSensor(sensor);
+  }
+
+  // 已创建OPC传感器变量才更新变量
+  if (sensor->materialized)
+  {
+    ValueVariant variant(sensor);
+    updateVariable(sensor->sensorId, publishedStatus(sensor), sourceTime(sensor), variant.variant);
+    writesApplied++;
+#if UA_MULTITHREADING >= 100
+    // 每次写入只持有一次服务器锁，每写入一块主动让出，网络线程可及时处理客户端请求
+    if (cfg.applyChunk > 0 && writesApplied % cfg.applyChunk == 0)
+    {
+      std::this_thread::yield();
+    }
+#endif
+  }
+}
+
+// 应用传感器的新数值，只依赖传感器本身，可供按ID直接更新的数据源使用
+inline void applySensorValue(Sensor *sensor, UA_StatusCode status, int64_t updateTs, const SensorValue &value)
+{
+  commitSensorValue(sensor, filterSensorValue(sensor, status, updateTs, value), status, updateTs, value);
+}
+
+// DecodedSensor结构体，解码阶段得到的传感器数据和过滤结果
+struct DecodedSensor
+{
+  int sensorId;
+  uint8_t typeId;
+  // 注册表中已有传感器的槽位，新传感器为FlatIndex::npos
+  uint32_t slot;
+  Verdict verdict;
+  UA_StatusCode status;
+  int64_t updateTs;
+  SensorValue value;
+  // 新传感器的名称，指向页面JSON数据
+  const nlohmann::json *sensorName;
+};
+
+// 解码并校验传感器数据，只读取注册表，可在解码线程执行
+inline bool decodeSensorData(nlohmann::json &sensorData, DecodedSensor &decoded)
+{
+  // 检查传感器参数id
+  if (sensorData["id"] == nullptr)
+  {
+    OPC_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "未找到传感器参数id");
+    OPC_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "%s", nlohmann::to_string(sensorData).c_str());
+    return false;
+  }
+  // 检查传感器参数sensorName
+  if (sensorData["sensorName"] == nullptr)
+  {
+    OPC_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "未找到传感器参数sensorName");
+    OPC_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "%s", nlohmann::to_string(sensorData).c_str());
+    return false;
+  }
+  // 检查传感器参数isLine
+  if (sensorData["isLine"] == nullptr)
+  {
+    OPC_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "未找到传感器参数isLine");
+    OPC_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "%s", nlohmann::to_string(sensorData).c_str());
+    return false;
+  }
+  // 检查传感器参数updateDate
+  if (sensorData["updateDate"] == nullptr)
+  {
+    OPC_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "未找到传感器参数updateDate");
+    OPC_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "%s", nlohmann::to_string(sensorData).c_str());
+    return false;
+  }
+  // 检查传感器参数sensorTypeId
+  if (sensorData["sensorTypeId"] == nullptr)
+  {
+    OPC_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "未找到传感器参数sensorTypeId");
+    OPC_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "%s", nlohmann::to_string(sensorData).c_str());
+    return false;
+  }
+
+  // 声明传感器数值
+  SensorValue value;
+
+  // 获取传感器类型ID
+  int typeId = sensorData["sensorTypeId"];
+  if (typeId == 1 || typeId == 4 || typeId == 6 || typeId == 8)
+  {
+    // 检查传感器参数value
+    if (sensorData["value"] == nullptr)
+    {
+      OPC_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "未找到传感器参数value");
+      OPC_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "%s", nlohmann::to_string(sensorData).c_str());
+      return false;
+    }
+    std::string valStr = sensorData["value"];
+    if (typeId == 1)
+    {
+      // 检查传感器参数decimalPlacse
+      if (sensorData["decimalPlacse"] == nullptr)
+      {
+        OPC_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "未找到传感器参数decimalPlacse");
+        OPC_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "%s", nlohmann::to_string(sensorData).c_str());
+        return false;
+      }
+      // 获取小数位长度值字符串并转化为数值
+      std::string lenStr = sensorData["decimalPlacse"];
+      int len = std::stoi(lenStr);
+      // 长度大于0是浮点数，否则就是整数
+      if (len > 0)
+      {
+        // 浮点数
+        value.type = VALUE_FLOAT;
+        value.number = std::stof(valStr);
+      }
+      else
+      {
+        // 整数
+        value.type = VALUE_INTEGER;
+        value.number = (UA_IntegerId)std::stoi(valStr);
+      }
+    }
+    else
+    {
+      // 字符串
+      value.type = VALUE_STRING;
+      value.text = valStr;
+    }
+  }
+  else if (typeId == 2 || typeId == 5)
+  {
+    // 检查传感器参数switcher
+    if (sensorData["switcher"] == nullptr)
+    {
+      OPC_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "未找到传感器参数switcher");
+      OPC_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "%s", nlohmann::to_string(sensorData).c_str());
+      return false;
+    }
+    // 将开关转换为布尔值
+    int switcher = sensorData["switcher"];
+    value.type = VALUE_BOOLEAN;
+    value.number = switcher > 0;
+  }
+  else
+  {
+    OPC_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "不支持的传感器类型ID: %d", typeId);
+    return false;
+  }
+
+  // 获取是否在线
+  int isLineValue = sensorData["isLine"];
+  // 转换为传感器状态
+  UA_StatusCode status = isLineValue > 0 ? UA_STATUSCODE_GOOD : UA_STATUSCODE_BAD;
+
+  // 获取更新时间
+  std::string updateDate = sensorData["updateDate"];
+  int64_t updateTs = parseUpdateDate(updateDate);
+  if (updateTs < 0)
+  {
+    OPC_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "传感器参数updateDate格式错误");
+    OPC_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "%s", nlohmann::to_string(sensorData).c_str());
+    return false;
+  }
+
+  decoded.sensorId = sensorData["id"];
+  decoded.typeId = (uint8_t)typeId;
+  decoded.status = status;
+  decoded.updateTs = updateTs;
+  decoded.value = std::move(value);
+  decoded.sensorName = &sensorData["sensorName"];
+
+  // 通过传感器参数id查找传感器并过滤新数值，新传感器总是写入
+  decoded.slot = registry.sensorIndex.find((uint32_t)decoded.sensorId);
+  decoded.verdict = decoded.slot == FlatIndex::npos
+                        ? VERDICT_WRITE
+                        : filterSensorValue(&registry.sensors[decoded.slot], status, updateTs, decoded.value);
+  return true;
+}
+
+// 应用解码后的传感器数据，新建传感器并提交新数值，只在拉取线程执行
+inline void applyDecodedSensor(Device *device, DecodedSensor &decoded)
+{
+  Sensor *sensor = nullptr;
+  Verdict verdict = decoded.verdict;
+  if (decoded.slot != FlatIndex::npos)
+  {
+    sensor = &registry.sensors[decoded.slot];
+    // 同一页中重复出现的传感器已被前一条更新
+    if (sensor->updateTs == decoded.updateTs)
+    {
+      verdict = VERDICT_UNCHANGED;
+    }
+  }
+  else
+  {
+    // 同一页中重复出现的新传感器已由前一条创建，按当前状态重新过滤
+    sensor = registry.findSensor(decoded.sensorId);
+    if (sensor != nullptr)
+    {
+      verdict = filterSensorValue(sensor, decoded.status, decoded.updateTs, decoded.value);
+    }
+  }
+  bool created = sensor == nullptr;
+  if (created)
+  {
+    // 新建传感器并加入注册表
+    sensor = registry.addSensor(device, decoded.sensorId, namePool.intern(*decoded.sensorName));
+  }
+  sensor->typeId = decoded.typeId;
+
+  // 应用新数值
+  commitSensorValue(sensor, verdict, decoded.status, decoded.updateTs, decoded.value);
+
+  // 懒加载且设备未物化时，只记录数值不创建OPC传感器变量
+  if (created && device->materialized)
+  {
+    materializeSensor(sensor);
+  }
+}
+
+// 更新传感器数据
+inline void updateSensorData(Device *device, nlohmann::json sensorData)
+{
+  DecodedSensor decoded;
+  if (decodeSensorData(sensorData, decoded))
+  {
+    applyDecodedSensor(device, decoded);
+  }
+}
+
+// 声明文件夹空间索引
+inline UA_UInt16 folderNsIndex;
+
+// 创建OPC文件夹对象
+inline UA_StatusCode createFolderObject(int id, int pid, const char *name, const char *desc)
+{
+  UA_ObjectAttributes oAttr = UA_ObjectAttributes_default;
+  // 添加节点时会深拷贝属性，直接引用名称缓冲区即可
+  oAttr.description = UA_LOCALIZEDTEXT((char *)"zh-CN", (char *)desc);
+  oAttr.displayName = UA_LOCALIZEDTEXT((char *)"zh-CN", (char *)name);
+
+  UA_UInt16 pNsIndex = folderNsIndex++;
+  if (pid == UA_NS0ID_OBJECTSFOLDER)
+  {
+    pNsIndex = 0;
+  }
+
+  UA_StatusCode retval = UA_Server_addObjectNode(
+      opcServer,                                   // server
+      UA_NODEID_NUMERIC(folderNsIndex, id),        // requestedNewNodeId
+      UA_NODEID_NUMERIC(pNsIndex, pid),            // parentNodeId
+      UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT), // referenceTypeId
+      UA_QUALIFIEDNAME(folderNsIndex, (char *)name), // browseName
+      UA_NODEID_NUMERIC(0, UA_NS0ID_FOLDERTYPE),   // typeDefinition
+      oAttr,                                       // objectAttributes
+      NULL, NULL);
+  OPC_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "%s|创建OPC文件夹对象[%s]", UA_StatusCode_name(retval), name);
+
+  return retval;
+}
+
+// 创建OPC设备对象
+inline UA_StatusCode createDeviceObject(int id, int pid, const char *name, const char *desc, void *context)
+{
+  UA_ObjectAttributes oAttr = UA_ObjectAttributes_default;
+  // 添加节点时会深拷贝属性，直接引用名称缓冲区即可
+  oAttr.description = UA_LOCALIZEDTEXT((char *)"zh-CN", (char *)desc);
+  oAttr.displayName = UA_LOCALIZEDTEXT((char *)"zh-CN", (char *)name);
+
+  UA_StatusCode retval = UA_Server_addObjectNode(
+      opcServer,                                     // server
+      UA_NODEID_NUMERIC(deviceNsIndex, id),          // requestedNewNodeId
+      UA_NODEID_NUMERIC(folderNsIndex, pid),         // parentNodeId
+      UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT),   // referenceTypeId
+      UA_QUALIFIEDNAME(deviceNsIndex, (char *)name), // browseName
+      UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE), // typeDefinition
+      oAttr,                                         // objectAttributes
+      context, NULL);
+
+  OPC_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "%s|创建OPC设备对象[%s]", UA_StatusCode_name(retval), name);
+
+  return retval;
+}
+
+// 声明并初始化文件夹ID
+inline int folderId = 1;
+
+// DecodedDevice结构体，解码阶段得到的一台设备的数据
+struct DecodedDevice
+{
+  // 设备参数是否完整，不完整的设备不应用
+  bool valid = false;
+  // 设备JSON数据，新建设备时读取名称和编号
+  nlohmann::json *data = nullptr;
+  std::vector<DecodedSensor> sensors;
+};
+
+// 解码并校验设备数据及其传感器数据，只读取注册表，可在解码线程执行
+inline void decodeDeviceData(nlohmann::json &deviceData, DecodedDevice &decoded)
+{
+  decoded.data = &deviceData;
+  // 检查设备参数id
+  if (deviceData["id"] == nullptr)
+  {
+    OPC_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "未找到设备参数id");
+    OPC_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "%s", nlohmann::to_string(deviceData).c_str());
+    return;
+  }
+  // 检查设备参数deviceName
+  if (deviceData["deviceName"] == nullptr)
+  {
+    OPC_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "未找到设备参数deviceName");
+    OPC_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "%s", nlohmann::to_string(deviceData).c_str());
+    return;
+  }
+  // 检查设备参数deviceNo
+  if (deviceData["deviceNo"] == nullptr)
+  {
+    OPC_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "未找到设备参数deviceNo");
+    OPC_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "%s", nlohmann::to_string(deviceData).c_str());
+    return;
+  }
+  decoded.valid = true;
+
+  // 检查设备参数sensorsList
+  if (deviceData["sensorsList"] == nullptr)
+  {
+    OPC_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "未找到设备参数sensorsList");
+    OPC_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "%s", nlohmann::to_string(deviceData).c_str());
+    return;
+  }
+  // 检查设备参数sensorsList是否为数组
+  if (!deviceData["sensorsList"].is_array())
+  {
+    OPC_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "sensorsList不是有效的数组类型");
+    OPC_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "%s", nlohmann::to_string(deviceData["sensorsList"]).c_str());
+    return;
+  }
+  // 遍历sensorsList数组，解码并过滤传感器数据
+  nlohmann::json &sensorsList = deviceData["sensorsList"];
+  decoded.sensors.resize(sensorsList.size());
+  size_t count = 0;
+  for (nlohmann::json &sensorData : sensorsList)
+  {
+    if (decodeSensorData(sensorData, decoded.sensors[count]))
+    {
+      count++;
+    }
+  }
+  decoded.sensors.resize(count);
+}
+
+// 应用解码后的设备数据，新建设备和传感器并写入变量，只在拉取线程执行
+inline void applyDeviceData(DecodedDevice &decoded)
+{
+  if (!decoded.valid)
+  {
+    return;
+  }
+  nlohmann::json &deviceData = *decoded.data;
+
+  // 通过设备参数id查找设备
+  Device *device = registry.findDevice(deviceData["id"]);
+  if (device == nullptr)
+  {
+    // 新建设备并加入注册表
+    device = registry.addDevice(deviceData["id"]);
+    device->deviceNo = deviceData["deviceNo"];
+    std::string deviceName = deviceData["deviceName"];
+    // 如果是默认设备名称就加上设备ID
+    if (deviceName == "4G压力表")
+    {
+      deviceName += "(" + std::to_string(device->deviceId) + ")";
+    }
+    device->deviceName = namePool.intern(deviceName);
+    // 懒加载模式下设备传感器变量待首次访问时再物化
+    device->materialized = !cfg.lazyNodes;
+    registryDirty = true;
+
+    // 创建OPC设备对象
+    UA_StatusCode retval = createDeviceObject(device->deviceId, folderId, device->deviceName->c_str(), device->deviceNo.c_str(), deviceContext(device));
+    // 如果创建OPC设备对象失败，则返回
+    if (retval != UA_STATUSCODE_GOOD)
+    {
+      return;
+    }
+  }
+
+  // 按顺序应用传感器数据
+  for (DecodedSensor &sensor : decoded.sensors)
+  {
+    applyDecodedSensor(device, sensor);
+  }
+}
+
+// 更新设备数据
+inline void updateDeviceData(nlohmann::json deviceData)
+{
+  DecodedDevice decoded;
+  decodeDeviceData(deviceData, decoded);
+  applyDeviceData(decoded);
+}
+
+#endif
@@ -0,0 +1,327 @@
+//
+//  journal.h
+//
+//  只追加的二进制日志，记录先写入内存缓冲区，组提交时交给写线程一次写入并落盘，
+//  调用方不等待磁盘，需要确认落盘时调用sync
+//  每条记录格式为[长度][校验和][数据]，回放时遇到不完整或校验失败的记录即停止
+//
+
+#ifndef OPC_JOURNAL_H
+#define OPC_JOURNAL_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#if defined(_WIN16) || defined(_WIN32) || defined(_WIN64)
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Journal结构体
+struct Journal
+{
+  Journal() = default;
+  Journal(const Journal &) = delete;
+  Journal &operator=(const Journal &) = delete;
+
+  ~Journal()
+  {
+    close();
+  }
+
+  // 以追加方式打开日志文件
+  bool open(const char *filePath)
+  {
+    close();
+    path = filePath;
+    file = fopen(filePath, "ab");
+    if (file == nullptr)
+    {
+      return false;
+    }
+    fseek(file, 0, SEEK_END);
+    fileSize = (size_t)ftell(file);
+    failed = false;
+    stopping = false;
+    writer = std::thread([this] { writeLoop(); });
+    return true;
+  }
+
+  // 是否已打开
+  bool isOpen() const
+  {
+    return file != nullptr;
+  }
+
+  // 追加一条记录到缓冲区，数据可分为定长和变长两部分
+  void append(const void *data, uint32_t size, const void *extra = nullptr, uint32_t extraSize = 0)
+  {
+    uint32_t length = size + extraSize;
+    uint32_t checksum = fnv1a(fnv1a(2166136261u, data, size), extra, extraSize);
+    buffer.append((const char *)&length, sizeof(length));
+    buffer.append((const char *)&checksum, sizeof(checksum));
+    buffer.append((const char *)data, size);
+    if (extraSize > 0)
+    {
+      buffer.append((const char *)extra, extraSize);
+    }
+    pending++;
+  }
+
+  // 组提交，将缓冲区交给写线程写入文件并落盘后立即返回，返回false表示之前提交的记录写入失败
+  bool commit()
+  {
+    if (file == nullptr)
+    {
+      return true;
+    }
+    std::lock_guard<std::mutex> guard(lock);
+    if (!buffer.empty())
+    {
+      fileSize += buffer.size();
+      // 写线程落后时接在未写入的数据之后
+      if (queued.empty())
+      {
+        queued.swap(buffer);
+      }
+      else
+      {
+        queued.append(buffer);
+      }
+      queuedRecords += pending;
+      buffer.clear();
+      pending = 0;
+      wake.notify_one();
+    }
+    bool ok = !failed;
+    failed = false;
+    return ok;
+  }
+
+  // 组提交并等待已提交的记录全部落盘，返回是否全部写入成功
+  bool sync()
+  {
+    bool ok = commit();
+    std::unique_lock<std::mutex> guard(lock);
+    idle.wait(guard, [this] { return queued.empty() && !writing; });
+    ok = ok && !failed;
+    failed = false;
+    return ok;
+  }
+
+  // 已提交的日志大小，包括写线程尚未落盘的部分
+  size_t size() const
+  {
+    return fileSize;
+  }
+
+  // 缓冲区中待提交的字节数
+  size_t buffered() const
+  {
+    return buffer.size();
+  }
+
+  // 清空日志文件，在记录已合并到快照后调用
+  bool truncate()
+  {
+    if (file == nullptr)
+    {
+      return false;
+    }
+    // 等写线程写完已提交的记录，这些记录已在快照中，随后一起清空
+    std::unique_lock<std::mutex> guard(lock);
+    idle.wait(guard, [this] { return queued.empty() && !writing; });
+    fclose(file);
+    file = fopen(path.c_str(), "wb");
+    if (file == nullptr)
+    {
+      return false;
+    }
+    fclose(file);
+    file = fopen(path.c_str(), "ab");
+    fileSize = 0;
+    return file != nullptr;
+  }
+
+  // 关闭日志文件，已提交的记录由写线程写完后退出，未提交的记录会被丢弃
+  void close()
+  {
+    if (writer.joinable())
+    {
+      {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+      }
+      wake.notify_one();
+      writer.join();
+    }
+    if (file != nullptr)
+    {
+      fclose(file);
+      file = nullptr;
+    }
+    buffer.clear();
+    pending = 0;
+  }
+
+  // 回放日志文件中的完整记录，回调参数为数据指针和长度，返回回放的记录数
+  // validBytes不为空时写入最后一条完整记录的结束位置，fileBytes不为空时写入文件大小，
+  // 两者不等说明文件末尾有崩溃时写入不完整的记录
+  template <typename Callback>
+  static size_t replay(const char *filePath, Callback callback, size_t *validBytes = nullptr,
+                       size_t *fileBytes = nullptr)
+  {
+    if (validBytes != nullptr)
+    {
+      *validBytes = 0;
+    }
+    if (fileBytes != nullptr)
+    {
+      *fileBytes = 0;
+    }
+    FILE *in = fopen(filePath, "rb");
+    if (in == nullptr)
+    {
+      return 0;
+    }
+    std::string data;
+    char chunk[65536];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), in)) > 0)
+    {
+      data.append(chunk, n);
+    }
+    fclose(in);
+
+    size_t count = 0;
+    size_t pos = 0;
+    while (pos + 8 <= data.size())
+    {
+      uint32_t length, checksum;
+      memcpy(&length, data.data() + pos, sizeof(length));
+      memcpy(&checksum, data.data() + pos + 4, sizeof(checksum));
+      if (pos + 8 + length > data.size() || fnv1a(2166136261u, data.data() + pos + 8, length) != checksum)
+      {
+        break;
+      }
+      callback(data.data() + pos + 8, length);
+      pos += 8 + length;
+      count++;
+    }
+    if (validBytes != nullptr)
+    {
+      *validBytes = pos;
+    }
+    if (fileBytes != nullptr)
+    {
+      *fileBytes = data.size();
+    }
+    return count;
+  }
+
+  // 把日志文件截断到指定长度并落盘，回放后、追加打开前去掉不完整的尾部，
+  // 否则之后提交的记录写在尾部之后，下次回放在同一位置停止而全部丢失
+  static bool truncateTo(const char *filePath, size_t length)
+  {
+#if defined(_WIN16) || defined(_WIN32) || defined(_WIN64)
+    int fd = _open(filePath, _O_RDWR | _O_BINARY);
+    if (fd < 0)
+    {
+      return false;
+    }
+    bool ok = _chsize_s(fd, (long long)length) == 0 && _commit(fd) == 0;
+    _close(fd);
+#else
+    int fd = ::open(filePath, O_RDWR);
+    if (fd < 0)
+    {
+      return false;
+    }
+    bool ok = ftruncate(fd, (off_t)length) == 0 && fsync(fd) == 0;
+    ::close(fd);
+#endif
+    return ok;
+  }
+
+  // 统计已落盘的次数和记录数
+  size_t commits = 0;
+  size_t records = 0;
+
+private:
+  FILE *file = nullptr;
+  std::string path;
+  std::string buffer;
+  size_t fileSize = 0;
+  size_t pending = 0;
+
+  // 写线程，queued为已提交待写入的数据，writing表示正在写入和落盘
+  std::thread writer;
+  std::mutex lock;
+  std::condition_variable wake;
+  std::condition_variable idle;
+  std::string queued;
+  size_t queuedRecords = 0;
+  bool writing = false;
+  bool stopping = false;
+  bool failed = false;
+
+  // 写线程循环，每次取出全部已提交的数据一次写入并落盘，落盘期间不持有锁
+  void writeLoop()
+  {
+    std::unique_lock<std::mutex> guard(lock);
+    while (true)
+    {
+      wake.wait(guard, [this] { return stopping || !queued.empty(); });
+      if (queued.empty())
+      {
+        return;
+      }
+      std::string data;
+      data.swap(queued);
+      size_t count = queuedRecords;
+      queuedRecords = 0;
+      FILE *target = file;
+      writing = true;
+      guard.unlock();
+      bool ok = target != nullptr && fwrite(data.data(), 1, data.size(), target) == data.size() && fflush(target) == 0;
+#if defined(_WIN16) || defined(_WIN32) || defined(_WIN64)
+      ok = ok && _commit(_fileno(target)) == 0;
+#else
+      ok = ok && fsync(fileno(target)) == 0;
+#endif
+      guard.lock();
+      writing = false;
+      if (ok)
+      {
+        commits++;
+        records += count;
+      }
+      else
+      {
+        failed = true;
+      }
+      idle.notify_all();
+    }
+  }
+
+  // FNV-1a校验和
+  static uint32_t fnv1a(uint32_t hash, const void *data, size_t size)
+  {
+    const unsigned char *p = (const unsigned char *)data;
+    for (size_t i = 0; i < size; i++)
+    {
+      hash = (hash ^ p[i]) * 16777619u;
+    }
+    return hash;
+  }
+};
+
+#endif
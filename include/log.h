@@ -0,0 +1,56 @@
+//
+//  log.h
+//
+//  日志门面，宏先判断级别是否启用，未启用时不求值任何参数，拼接字符串和序列化JSON都不会发生；
+//  低于编译期下限OPC_LOG_FLOOR的级别条件为常量false，整条语句在编译期被消除
+//  运行时级别由setLogLevel设置，应与服务器日志器的级别一致；级别统一按UA_LOGLEVEL的100到600比较，
+//  兼容UA_LogLevel枚举为0到5（1.3及以前）和100到600（1.4起）的版本
+//
+
+#ifndef OPC_LOG_H
+#define OPC_LOG_H
+
+#include <atomic>
+#include <open62541/plugin/log.h>
+
+// 编译期日志级别下限，默认与open62541的UA_LOGLEVEL相同
+#ifndef OPC_LOG_FLOOR
+#ifdef UA_LOGLEVEL
+#define OPC_LOG_FLOOR UA_LOGLEVEL
+#else
+#define OPC_LOG_FLOOR 300
+#endif
+#endif
+
+// 日志级别对应的100到600的等级
+inline int logRank(UA_LogLevel level)
+{
+  return (int)level < 100 ? ((int)level + 1) * 100 : (int)level;
+}
+
+// 运行时日志等级，设置前不过滤，由日志器自行过滤
+inline std::atomic<int> logThreshold{0};
+
+inline void setLogLevel(UA_LogLevel level)
+{
+  logThreshold.store(logRank(level), std::memory_order_relaxed);
+}
+
+// 等级是否启用，编译期下限在前，被消除的等级不读取运行时级别
+#define OPC_LOG_AT(rank, func, ...)                                                                                    \
+  do                                                                                                                   \
+  {                                                                                                                    \
+    if ((rank) >= OPC_LOG_FLOOR && (rank) >= logThreshold.load(std::memory_order_relaxed))                             \
+    {                                                                                                                  \
+      func(__VA_ARGS__);                                                                                               \
+    }                                                                                                                  \
+  } while (0)
+
+#define OPC_LOG_TRACE(...) OPC_LOG_AT(100, UA_LOG_TRACE, __VA_ARGS__)
+#define OPC_LOG_DEBUG(...) OPC_LOG_AT(200, UA_LOG_DEBUG, __VA_ARGS__)
+#define OPC_LOG_INFO(...) OPC_LOG_AT(300, UA_LOG_INFO, __VA_ARGS__)
+#define OPC_LOG_WARNING(...) OPC_LOG_AT(400, UA_LOG_WARNING, __VA_ARGS__)
+#define OPC_LOG_ERROR(...) OPC_LOG_AT(500, UA_LOG_ERROR, __VA_ARGS__)
+#define OPC_LOG_FATAL(...) OPC_LOG_AT(600, UA_LOG_FATAL, __VA_ARGS__)
+
+#endif
@@ -0,0 +1,197 @@
+//
+//  mapped_file.h
+//
+//  跨平台的整文件内存映射，用于注册表快照的写入和加载
+//
+
+#ifndef OPC_MAPPED_FILE_H
+#define OPC_MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+
+#if defined(_WIN16) || defined(_WIN32) || defined(_WIN64)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// MappedFile结构体，只读映射已有文件，或创建指定大小的文件并读写映射
+struct MappedFile
+{
+  void *data = nullptr;
+  size_t size = 0;
+
+  MappedFile() = default;
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  ~MappedFile()
+  {
+    close();
+  }
+
+  // 只读映射文件
+  bool openRead(const char *path)
+  {
+#if defined(_WIN16) || defined(_WIN32) || defined(_WIN64)
+    file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+      return false;
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+    {
+      close();
+      return false;
+    }
+    size = (size_t)fileSize.QuadPart;
+    mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    data = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+#else
+    fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+    {
+      return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+      close();
+      return false;
+    }
+    size = (size_t)st.st_size;
+    data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED)
+    {
+      data = nullptr;
+    }
+#endif
+    if (data == nullptr)
+    {
+      close();
+      return false;
+    }
+    return true;
+  }
+
+  // 创建或截断文件为指定大小并读写映射
+  bool create(const char *path, size_t length)
+  {
+    size = length;
+#if defined(_WIN16) || defined(_WIN32) || defined(_WIN64)
+    file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+      return false;
+    }
+    mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE, (DWORD)((unsigned long long)length >> 32), (DWORD)length, NULL);
+    data = mapping ? MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0) : nullptr;
+#else
+    fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+      return false;
+    }
+    if (ftruncate(fd, (off_t)length) != 0)
+    {
+      close();
+      return false;
+    }
+    data = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED)
+    {
+      data = nullptr;
+    }
+#endif
+    if (data == nullptr)
+    {
+      close();
+      return false;
+    }
+    return true;
+  }
+
+  // 将映射内容刷入磁盘
+  bool flush()
+  {
+#if defined(_WIN16) || defined(_WIN32) || defined(_WIN64)
+    return FlushViewOfFile(data, size) && FlushFileBuffers(file);
+#else
+    return msync(data, size, MS_SYNC) == 0;
+#endif
+  }
+
+  // 解除映射并关闭文件
+  void close()
+  {
+#if defined(_WIN16) || defined(_WIN32) || defined(_WIN64)
+    if (data != nullptr)
+    {
+      UnmapViewOfFile(data);
+    }
+    if (mapping != NULL)
+    {
+      CloseHandle(mapping);
+      mapping = NULL;
+    }
+    if (file != INVALID_HANDLE_VALUE)
+    {
+      CloseHandle(file);
+      file = INVALID_HANDLE_VALUE;
+    }
+#else
+    if (data != nullptr)
+    {
+      munmap(data, size);
+    }
+    if (fd >= 0)
+    {
+      ::close(fd);
+      fd = -1;
+    }
+#endif
+    data = nullptr;
+    size = 0;
+  }
+
+private:
+#if defined(_WIN16) || defined(_WIN32) || defined(_WIN64)
+  HANDLE file = INVALID_HANDLE_VALUE;
+  HANDLE mapping = NULL;
+#else
+  int fd = -1;
+#endif
+};
+
+// 用新文件原子替换旧文件
+inline bool replaceFile(const char *from, const char *to)
+{
+#if defined(_WIN16) || defined(_WIN32) || defined(_WIN64)
+  return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+  if (rename(from, to) != 0)
+  {
+    return false;
+  }
+  // 目录项的修改要落盘目录本身，否则掉电后可能仍是旧文件，而之后清空的变更日志已经落盘
+  std::string dir(to);
+  size_t slash = dir.rfind('/');
+  dir = slash == std::string::npos ? "." : slash == 0 ? "/" : dir.substr(0, slash);
+  int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+  if (fd < 0)
+  {
+    return false;
+  }
+  bool ok = fsync(fd) == 0;
+  ::close(fd);
+  return ok;
+#endif
+}
+
+#endif
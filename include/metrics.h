@@ -0,0 +1,334 @@
+//
+//  metrics.h
+//
+//  Prometheus文本格式的运行指标，支持计数器、直方图、设定值和采集时读取的回调
+//  计数器和直方图按线程分片，每个线程第一次记录时登记自己的分片，之后只写自己的分片，
+//  写入为单写者的relaxed读改写，不加锁也不争用缓存行；采集时汇总所有分片，线程退出时分片的计数并入汇总后释放
+//  所有指标须在第一次记录之前定义
+//
+
+#ifndef OPC_METRICS_H
+#define OPC_METRICS_H
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class Metrics
+{
+public:
+  Metrics() : serial(nextSerial()->fetch_add(1) + 1)
+  {
+  }
+
+  Metrics(const Metrics &) = delete;
+  Metrics &operator=(const Metrics &) = delete;
+
+  // 定义计数器，labels为不含花括号的标签，如kind="server"，同名指标共用说明
+  size_t counter(const std::string &name, const std::string &help, const std::string &labels = "")
+  {
+    return define(name, help, labels, COUNTER, {});
+  }
+
+  // 定义直方图，bounds为升序的桶上界
+  size_t histogram(const std::string &name, const std::string &help, const std::vector<double> &bounds,
+                   const std::string &labels = "")
+  {
+    return define(name, help, labels, HISTOGRAM, bounds);
+  }
+
+  // 定义设定值，由set更新
+  size_t gauge(const std::string &name, const std::string &help, const std::string &labels = "")
+  {
+    size_t id = define(name, help, labels, GAUGE, {});
+    std::lock_guard<std::mutex> guard(lock);
+    metrics[id].value.reset(new std::atomic<uint64_t>(0));
+    return id;
+  }
+
+  // 定义采集时读取的指标，type为"counter"或"gauge"，read须可在采集线程调用
+  void collect(const std::string &name, const std::string &help, const char *type, std::function<double()> read,
+               const std::string &labels = "")
+  {
+    size_t id = define(name, help, labels, strcmp(type, "counter") == 0 ? COUNTER : GAUGE, {});
+    std::lock_guard<std::mutex> guard(lock);
+    metrics[id].read = std::move(read);
+  }
+
+  // 计数器加n
+  void add(size_t id, uint64_t n = 1)
+  {
+    std::atomic<uint64_t> &slot = local()[metrics[id].offset];
+    slot.store(slot.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+  }
+
+  // 直方图记录一个值
+  void observe(size_t id, double value)
+  {
+    const Metric &metric = metrics[id];
+    std::atomic<uint64_t> *slots = local() + metric.offset;
+    size_t bucket = 0;
+    while (bucket < metric.bounds.size() && value > metric.bounds[bucket])
+    {
+      bucket++;
+    }
+    // 桶计数不累积，采集时再累加；之后依次为总数和总和
+    size_t buckets = metric.bounds.size() + 1;
+    slots[bucket].store(slots[bucket].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    slots[buckets].store(slots[buckets].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    double sum = fromBits(slots[buckets + 1].load(std::memory_order_relaxed)) + value;
+    slots[buckets + 1].store(toBits(sum), std::memory_order_relaxed);
+  }
+
+  // 更新设定值
+  void set(size_t id, double value)
+  {
+    metrics[id].value->store(toBits(value), std::memory_order_relaxed);
+  }
+
+  // 汇总所有分片，输出Prometheus文本格式
+  std::string render()
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    std::lock_guard<std::mutex> shardGuard(pool->lock);
+    std::string text;
+    for (size_t i = 0; i < metrics.size(); i++)
+    {
+      const Metric &metric = metrics[i];
+      bool first = true;
+      for (size_t j = 0; j < i; j++)
+      {
+        first = first && metrics[j].name != metric.name;
+      }
+      if (first)
+      {
+        text += "# HELP " + metric.name + " " + metric.help + "\n";
+        text += "# TYPE " + metric.name + " " + typeName(metric.type) + "\n";
+      }
+      if (metric.read)
+      {
+        sample(text, metric.name, metric.labels, "", metric.read());
+      }
+      else if (metric.type == GAUGE)
+      {
+        sample(text, metric.name, metric.labels, "", fromBits(metric.value->load(std::memory_order_relaxed)));
+      }
+      else if (metric.type == COUNTER)
+      {
+        sample(text, metric.name, metric.labels, "", (double)sum(metric.offset));
+      }
+      else
+      {
+        size_t buckets = metric.bounds.size() + 1;
+        uint64_t cumulative = 0;
+        for (size_t b = 0; b < buckets; b++)
+        {
+          cumulative += sum(metric.offset + b);
+          sample(text, metric.name + "_bucket", metric.labels,
+                 b < metric.bounds.size() ? "le=\"" + number(metric.bounds[b]) + "\"" : "le=\"+Inf\"",
+                 (double)cumulative);
+        }
+        double total = fromBits(pool->retired[metric.offset + buckets + 1]);
+        for (const std::unique_ptr<std::atomic<uint64_t>[]> &shard : pool->shards)
+        {
+          total += fromBits(shard[metric.offset + buckets + 1].load(std::memory_order_relaxed));
+        }
+        sample(text, metric.name + "_sum", metric.labels, "", total);
+        sample(text, metric.name + "_count", metric.labels, "", (double)sum(metric.offset + buckets));
+      }
+    }
+    return text;
+  }
+
+private:
+  enum Type
+  {
+    COUNTER,
+    GAUGE,
+    HISTOGRAM,
+  };
+
+  struct Metric
+  {
+    std::string name;
+    std::string help;
+    std::string labels;
+    Type type;
+    std::vector<double> bounds;
+    // 在分片中的起始位置
+    size_t offset = 0;
+    std::shared_ptr<std::atomic<uint64_t>> value;
+    std::function<double()> read;
+  };
+
+  // 各线程的分片，由实例和线程缓存共享，实例销毁后退出的线程不再访问
+  struct ShardPool
+  {
+    std::mutex lock;
+    std::vector<std::unique_ptr<std::atomic<uint64_t>[]>> shards;
+    // 已退出线程的计数之和，按槽位保存
+    std::vector<uint64_t> retired;
+    // 槽位是否为直方图总和，按double的位模式相加
+    std::vector<bool> floating;
+
+    // 把分片的计数并入汇总并释放分片
+    void retire(std::atomic<uint64_t> *slots)
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      for (size_t i = 0; i < retired.size(); i++)
+      {
+        uint64_t value = slots[i].load(std::memory_order_relaxed);
+        retired[i] = floating[i] ? toBits(fromBits(retired[i]) + fromBits(value)) : retired[i] + value;
+      }
+      for (size_t i = 0; i < shards.size(); i++)
+      {
+        if (shards[i].get() == slots)
+        {
+          shards.erase(shards.begin() + i);
+          break;
+        }
+      }
+    }
+  };
+
+  // 线程缓存的分片，按实例序号区分，线程退出或改用其他实例时归还
+  struct LocalShard
+  {
+    uint64_t serial = 0;
+    std::atomic<uint64_t> *slots = nullptr;
+    std::weak_ptr<ShardPool> pool;
+
+    void release()
+    {
+      if (std::shared_ptr<ShardPool> owner = pool.lock())
+      {
+        owner->retire(slots);
+      }
+      pool.reset();
+      slots = nullptr;
+    }
+
+    ~LocalShard()
+    {
+      release();
+    }
+  };
+
+  const uint64_t serial;
+  std::mutex lock;
+  std::vector<Metric> metrics;
+  size_t slotCount = 0;
+  std::shared_ptr<ShardPool> pool = std::make_shared<ShardPool>();
+
+  static std::atomic<uint64_t> *nextSerial()
+  {
+    static std::atomic<uint64_t> value{0};
+    return &value;
+  }
+
+  size_t define(const std::string &name, const std::string &help, const std::string &labels, Type type,
+                const std::vector<double> &bounds)
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    Metric metric;
+    metric.name = name;
+    metric.help = help;
+    metric.labels = labels;
+    metric.type = type;
+    metric.bounds = bounds;
+    metric.offset = slotCount;
+    slotCount += type == COUNTER ? 1 : type == HISTOGRAM ? bounds.size() + 3 : 0;
+    metrics.push_back(metric);
+    std::lock_guard<std::mutex> shardGuard(pool->lock);
+    pool->retired.resize(slotCount, 0);
+    pool->floating.resize(slotCount, false);
+    if (type == HISTOGRAM)
+    {
+      pool->floating[slotCount - 1] = true;
+    }
+    return metrics.size() - 1;
+  }
+
+  // 当前线程的分片，第一次调用时登记
+  std::atomic<uint64_t> *local()
+  {
+    static thread_local LocalShard cache;
+    if (cache.serial != serial)
+    {
+      cache.release();
+      std::lock_guard<std::mutex> guard(pool->lock);
+      // 末尾多留一个缓存行，相邻分配的分片不共用有数据的缓存行
+      size_t padded = slotCount + 64 / sizeof(uint64_t);
+      pool->shards.emplace_back(new std::atomic<uint64_t>[padded]);
+      for (size_t i = 0; i < padded; i++)
+      {
+        pool->shards.back()[i].store(0, std::memory_order_relaxed);
+      }
+      cache.serial = serial;
+      cache.slots = pool->shards.back().get();
+      cache.pool = pool;
+    }
+    return cache.slots;
+  }
+
+  // 调用前持有pool->lock
+  uint64_t sum(size_t slot) const
+  {
+    uint64_t total = pool->retired[slot];
+    for (const std::unique_ptr<std::atomic<uint64_t>[]> &shard : pool->shards)
+    {
+      total += shard[slot].load(std::memory_order_relaxed);
+    }
+    return total;
+  }
+
+  static uint64_t toBits(double value)
+  {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+  }
+
+  static double fromBits(uint64_t bits)
+  {
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+
+  static const char *typeName(Type type)
+  {
+    return type == COUNTER ? "counter" : type == GAUGE ? "gauge" : "histogram";
+  }
+
+  static std::string number(double value)
+  {
+    if (std::isinf(value))
+    {
+      return value > 0 ? "+Inf" : "-Inf";
+    }
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.15g", value);
+    return buffer;
+  }
+
+  static void sample(std::string &text, const std::string &name, const std::string &labels, const std::string &extra,
+                     double value)
+  {
+    text += name;
+    if (!labels.empty() || !extra.empty())
+    {
+      text += "{" + labels + (!labels.empty() && !extra.empty() ? "," : "") + extra + "}";
+    }
+    text += " " + number(value) + "\n";
+  }
+};
+
+#endif
@@ -0,0 +1,186 @@
+//
+//  rcu.h
+//
+//  基于纪元的读多写少发布机制，单个写线程发布不可变版本，读线程固定当前版本
+//  读取时不加锁也不阻塞写线程，旧版本在所有可能持有它的读线程退出后回收
+//
+
+#ifndef OPC_RCU_H
+#define OPC_RCU_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Rcu结构体，读线程通过Reader占用一个纪元槽，写线程调用publish发布新版本
+template <typename T, size_t MaxReaders = 64>
+struct Rcu
+{
+  Rcu() = default;
+  Rcu(const Rcu &) = delete;
+  Rcu &operator=(const Rcu &) = delete;
+
+  ~Rcu()
+  {
+    delete current.load();
+    for (auto &item : retired)
+    {
+      delete item.second;
+    }
+  }
+
+  // Reader结构体，每个读线程持有一个，构造时占用纪元槽，析构时释放
+  struct Reader
+  {
+    explicit Reader(Rcu &owner) : rcu(owner)
+    {
+      for (slot = 0; slot < MaxReaders; slot++)
+      {
+        bool expected = false;
+        if (rcu.slots[slot].used.compare_exchange_strong(expected, true))
+        {
+          return;
+        }
+      }
+      slot = MaxReaders;
+    }
+
+    ~Reader()
+    {
+      if (slot < MaxReaders)
+      {
+        rcu.slots[slot].epoch.store(0, std::memory_order_release);
+        rcu.slots[slot].used.store(false, std::memory_order_release);
+      }
+    }
+
+    Reader(const Reader &) = delete;
+    Reader &operator=(const Reader &) = delete;
+
+    // 是否占用到纪元槽，槽位用尽时无法读取
+    bool valid() const
+    {
+      return slot < MaxReaders;
+    }
+
+    // 固定当前版本，在unpin前返回的指针一直有效，可能为空；未占用到纪元槽时返回空
+    const T *pin()
+    {
+      if (slot >= MaxReaders)
+      {
+        return nullptr;
+      }
+      rcu.slots[slot].epoch.store(rcu.epoch.load(std::memory_order_acquire), std::memory_order_seq_cst);
+      return rcu.current.load(std::memory_order_seq_cst);
+    }
+
+    // 解除固定
+    void unpin()
+    {
+      if (slot >= MaxReaders)
+      {
+        return;
+      }
+      rcu.slots[slot].epoch.store(0, std::memory_order_release);
+    }
+
+  private:
+    Rcu &rcu;
+    size_t slot;
+  };
+
+  // Guard结构体，作用域内固定当前版本
+  struct Guard
+  {
+    explicit Guard(Reader &owner) : reader(owner), value(owner.pin())
+    {
+    }
+
+    ~Guard()
+    {
+      reader.unpin();
+    }
+
+    Guard(const Guard &) = delete;
+    Guard &operator=(const Guard &) = delete;
+
+    const T *operator->() const
+    {
+      return value;
+    }
+
+    const T *get() const
+    {
+      return value;
+    }
+
+  private:
+    Reader &reader;
+    const T *value;
+  };
+
+  // 发布新版本并接管其所有权，只能由写线程调用
+  void publish(const T *value)
+  {
+    const T *old = current.exchange(value, std::memory_order_seq_cst);
+    uint64_t retiredEpoch = epoch.fetch_add(1, std::memory_order_seq_cst);
+    if (old != nullptr)
+    {
+      retired.emplace_back(retiredEpoch, old);
+    }
+    reclaim();
+  }
+
+  // 回收不再被任何读线程持有的旧版本，返回尚未回收的数量
+  size_t reclaim()
+  {
+    uint64_t oldest = UINT64_MAX;
+    for (size_t i = 0; i < MaxReaders; i++)
+    {
+      uint64_t readerEpoch = slots[i].epoch.load(std::memory_order_seq_cst);
+      if (readerEpoch != 0 && readerEpoch < oldest)
+      {
+        oldest = readerEpoch;
+      }
+    }
+    // 读线程固定的纪元大于版本退役时的纪元，说明读到的是之后发布的版本
+    size_t kept = 0;
+    for (auto &item : retired)
+    {
+      if (item.first < oldest)
+      {
+        delete item.second;
+      }
+      else
+      {
+        retired[kept++] = item;
+      }
+    }
+    retired.resize(kept);
+    return kept;
+  }
+
+  // 写线程直接读取当前版本
+  const T *latest() const
+  {
+    return current.load(std::memory_order_acquire);
+  }
+
+private:
+  struct alignas(64) Slot
+  {
+    std::atomic<bool> used{false};
+    // 读线程固定时的纪元，0表示未在读取
+    std::atomic<uint64_t> epoch{0};
+  };
+
+  std::atomic<const T *> current{nullptr};
+  std::atomic<uint64_t> epoch{1};
+  Slot slots[MaxReaders];
+  // 已退役的版本及其退役纪元，只由写线程访问
+  std::vector<std::pair<uint64_t, const T *>> retired;
+};
+
+#endif
@@ -0,0 +1,231 @@
+//
+//  work_steal.h
+//
+//  工作窃取线程池，用于拉取流程中每台设备耗时差异很大的解码、校验和死区过滤
+//  每个线程有自己的任务队列，任务按连续区间预先分配给各队列；线程从自己队列的尾部取任务，
+//  自己的队列空了就从其他队列的头部窃取，处理大设备的线程不会让其他线程空闲
+//  调用线程也作为一个工作线程参与执行
+//
+
+#ifndef OPC_WORK_STEAL_H
+#define OPC_WORK_STEAL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+class WorkStealingPool
+{
+public:
+  // 创建指定数量的工作线程，加上调用线程共workers + 1个队列
+  // onStart在每个工作线程开始时以线程编号1到workers调用，用于设置线程的CPU和优先级
+  explicit WorkStealingPool(size_t workers, std::function<void(size_t)> onStart = nullptr) : start(std::move(onStart))
+  {
+    for (size_t i = 0; i <= workers; i++)
+    {
+      queues.emplace_back(new Queue);
+    }
+    for (size_t i = 1; i <= workers; i++)
+    {
+      threads.emplace_back(&WorkStealingPool::workerLoop, this, i);
+    }
+  }
+
+  WorkStealingPool(const WorkStealingPool &) = delete;
+  WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+  ~WorkStealingPool()
+  {
+    {
+      std::lock_guard<std::mutex> guard(wakeLock);
+      stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread &thread : threads)
+    {
+      thread.join();
+    }
+  }
+
+  // 并行执行body(0)到body(count - 1)，每grain个下标为一个任务，全部完成后返回
+  // 任务中抛出的第一个异常在全部完成后从调用线程重新抛出
+  void forEach(size_t count, const std::function<void(size_t)> &body, size_t grain = 1)
+  {
+    if (count == 0)
+    {
+      return;
+    }
+    grain = grain == 0 ? 1 : grain;
+    job = &body;
+    error = nullptr;
+    remaining.store(count, std::memory_order_relaxed);
+
+    // 按连续区间分配到各队列，与静态分区的初始分配相同
+    size_t tasks = (count + grain - 1) / grain;
+    size_t share = (tasks + queues.size() - 1) / queues.size();
+    for (size_t q = 0; q < queues.size(); q++)
+    {
+      std::lock_guard<std::mutex> guard(queues[q]->lock);
+      for (size_t t = q * share; t < tasks && t < (q + 1) * share; t++)
+      {
+        queues[q]->tasks.push_back(Range{t * grain, std::min(count, (t + 1) * grain)});
+      }
+    }
+    {
+      std::lock_guard<std::mutex> guard(wakeLock);
+      generation++;
+    }
+    wake.notify_all();
+
+    runTasks(0);
+    // 所有队列已空，阻塞等待其他线程完成手上的最后一个任务
+    {
+      std::unique_lock<std::mutex> guard(doneLock);
+      done.wait(guard, [this]
+                { return remaining.load(std::memory_order_acquire) == 0; });
+    }
+    job = nullptr;
+    if (error)
+    {
+      std::rethrow_exception(error);
+    }
+  }
+
+  // 工作线程数，不含调用线程
+  size_t size() const
+  {
+    return threads.size();
+  }
+
+  // 累计窃取的任务数
+  size_t steals() const
+  {
+    return stolen.load(std::memory_order_relaxed);
+  }
+
+private:
+  struct Range
+  {
+    size_t begin;
+    size_t end;
+  };
+
+  struct Queue
+  {
+    std::mutex lock;
+    std::deque<Range> tasks;
+  };
+
+  std::vector<std::unique_ptr<Queue>> queues;
+  std::vector<std::thread> threads;
+  std::function<void(size_t)> start;
+  const std::function<void(size_t)> *job = nullptr;
+  std::atomic<size_t> remaining{0};
+  std::atomic<size_t> stolen{0};
+  std::mutex errorLock;
+  std::exception_ptr error;
+  std::mutex wakeLock;
+  std::condition_variable wake;
+  // 最后一个任务完成时唤醒调用线程
+  std::mutex doneLock;
+  std::condition_variable done;
+  uint64_t generation = 0;
+  bool stopping = false;
+
+  void workerLoop(size_t self)
+  {
+    if (start)
+    {
+      start(self);
+    }
+    uint64_t seen = 0;
+    for (;;)
+    {
+      {
+        std::unique_lock<std::mutex> guard(wakeLock);
+        wake.wait(guard, [this, seen]
+                  { return stopping || generation != seen; });
+        if (stopping)
+        {
+          return;
+        }
+        seen = generation;
+      }
+      runTasks(self);
+    }
+  }
+
+  // 执行自己队列的任务，之后窃取其他队列的任务，所有队列都空时返回
+  void runTasks(size_t self)
+  {
+    Range range;
+    while (pop(self, range) || steal(self, range))
+    {
+      try
+      {
+        for (size_t i = range.begin; i < range.end; i++)
+        {
+          (*job)(i);
+        }
+      }
+      catch (...)
+      {
+        std::lock_guard<std::mutex> guard(errorLock);
+        if (!error)
+        {
+          error = std::current_exception();
+        }
+      }
+      size_t count = range.end - range.begin;
+      if (remaining.fetch_sub(count, std::memory_order_acq_rel) == count && self != 0)
+      {
+        std::lock_guard<std::mutex> guard(doneLock);
+        done.notify_one();
+      }
+    }
+  }
+
+  // 从自己队列的尾部取任务，窃取端从头部取，两端很少争抢同一个任务
+  bool pop(size_t self, Range &range)
+  {
+    Queue &queue = *queues[self];
+    std::lock_guard<std::mutex> guard(queue.lock);
+    if (queue.tasks.empty())
+    {
+      return false;
+    }
+    range = queue.tasks.back();
+    queue.tasks.pop_back();
+    return true;
+  }
+
+  // 从其他队列的头部窃取任务
+  bool steal(size_t self, Range &range)
+  {
+    for (size_t i = 1; i < queues.size(); i++)
+    {
+      Queue &queue = *queues[(self + i) % queues.size()];
+      std::lock_guard<std::mutex> guard(queue.lock);
+      if (!queue.tasks.empty())
+      {
+        range = queue.tasks.front();
+        queue.tasks.pop_front();
+        stolen.fetch_add(1, std::memory_order_relaxed);
+        return true;
+      }
+    }
+    return false;
+  }
+};
+
+#endif
@@ -5,655 +5,2238 @@
 #define UA_LOGLEVEL 200
 #define CPPHTTPLIB_OPENSSL_SUPPORT
 #include "include/httplib.h"
+#include "include/flat_index.h"
+#include "include/mapped_file.h"
+#include "include/journal.h"
+#include "include/rcu.h"
+#include "include/work_steal.h"
+#include "include/affinity.h"
+#include "include/circuit_breaker.h"
+#include "include/log.h"
+#include "include/async_log.h"
+#include "include/metrics.h"
+#include "include/ingest.h"
+// 事件循环模式需要Linux的epoll和C++20协程
+#if defined(__linux__) && defined(__cpp_impl_coroutine)
+#define OPC_EVENT_LOOP 1
+#include "include/async_http.h"
+#include "include/coro.h"
+#else
+#define OPC_EVENT_LOOP 0
+#endif
+#if defined(_WIN16) || defined(_WIN32) || defined(_WIN64)
 #include <windows.h>
+#include <psapi.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#endif
 #include <variant>
+#include <climits>
+#include <random>
+#include <unordered_set>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include <nlohmann/json.hpp>
 #include <open62541/server.h>
 #include <open62541/server_config_default.h>
 #include <open62541/plugin/log_stdout.h>
+#include <open62541/plugin/nodestore.h>
 
 using namespace std;
 using namespace httplib;
 using namespace nlohmann;
 
-// 声明并初始化服务器配置
-UA_ServerConfig *serverCfg = nullptr;
-
-// 声明并初始化服务器对象
-UA_Server *opcServer = nullptr;
+// 异步日志器
+AsyncLog asyncLog;
 
-// 声明传感器空间索引
-UA_UInt16 sensorNsIndex;
+// 运行指标，记录在拉取流程中的指标在此定义，采集时读取的指标由define_collected_metrics在启动时定义
+Metrics metrics;
 
-// 更新变量值
-void updateVariable(int sensorId, UA_StatusCode status, UA_Variant value)
+// 上游错误的分类，传输错误包括连接失败和超时
+enum UpstreamErrorKind
 {
-  // 获取变量节点ID
-  UA_NodeId nodeId = UA_NODEID_NUMERIC(sensorNsIndex, sensorId);
+  UPSTREAM_TRANSPORT,
+  UPSTREAM_THROTTLED,
+  UPSTREAM_SERVER,
+  UPSTREAM_CLIENT,
+  UPSTREAM_ERROR_KINDS,
+};
 
-  // 写入变量的数值
-  auto rv = UA_Server_writeValue(opcServer, nodeId, value);
-  const char *mv = rv == UA_STATUSCODE_GOOD ? "写入数值成功" : "写入数值失败";
-  UA_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, mv);
+// MetricIds结构体，各运行指标的编号
+struct MetricIds
+{
+  size_t cycleSeconds;
+  size_t pageFetchSeconds;
+  size_t pageParseSeconds;
+  size_t bytesReceived;
+  size_t writesApplied;
+  size_t writesSuppressed;
+  size_t cycleWritesApplied;
+  size_t cycleWritesSuppressed;
+  size_t upstreamErrors[UPSTREAM_ERROR_KINDS];
+};
 
-  if (status != UA_STATUSCODE_GOOD)
+MetricIds define_metrics()
+{
+  MetricIds ids;
+  ids.cycleSeconds = metrics.histogram("opc_cycle_duration_seconds", "拉取周期耗时",
+                                       {0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30, 60, 120});
+  ids.pageFetchSeconds = metrics.histogram("opc_page_fetch_seconds", "设备页请求耗时，包括重试",
+                                           {0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10});
+  ids.pageParseSeconds = metrics.histogram("opc_page_parse_seconds", "设备页JSON解析和解码耗时",
+                                           {0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5});
+  ids.bytesReceived = metrics.counter("opc_upstream_received_bytes_total", "上游响应体字节数");
+  ids.writesApplied = metrics.counter("opc_writes_applied_total", "写入变量的传感器值数");
+  ids.writesSuppressed = metrics.counter("opc_writes_suppressed_total", "未变化或在死区内而未写入的传感器值数");
+  ids.cycleWritesApplied = metrics.gauge("opc_cycle_writes_applied", "上一拉取周期写入的传感器值数");
+  ids.cycleWritesSuppressed = metrics.gauge("opc_cycle_writes_suppressed", "上一拉取周期未写入的传感器值数");
+  const char *kinds[] = {"transport", "throttled", "server", "client"};
+  for (int kind = 0; kind < UPSTREAM_ERROR_KINDS; kind++)
   {
-    // 声明并初始化写入值
-    UA_WriteValue wv;
-    UA_WriteValue_init(&wv);
-
-    // 设定写入值的节点ID和属性类型
-    wv.nodeId = nodeId;
-    wv.attributeId = UA_ATTRIBUTEID_VALUE;
-
-    // 写入变量的状态
-    wv.value.hasStatus = true;
-    wv.value.status = status;
-    auto rs = UA_Server_write(opcServer, &wv);
-    const char *ms = rs == UA_STATUSCODE_GOOD ? "写入状态成功" : "写入状态失败";
-    UA_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, ms);
+    ids.upstreamErrors[kind] = metrics.counter("opc_upstream_errors_total", "上游请求错误数，每次重试单独计数",
+                                               string("kind=\"") + kinds[kind] + "\"");
   }
+  return ids;
 }
 
-// 声明设备空间索引
-UA_UInt16 deviceNsIndex;
+MetricIds metric = define_metrics();
 
-// 创建OPC传感器变量
-UA_StatusCode createSensorVariable(int id, int pid, const char *name, const char *desc, UA_Variant value)
+// Diagnostics结构体，发布为OPC诊断变量的自诊断数据中由请求线程累计的部分，
+// 诊断变量为数据源变量，客户端读取或采样时才取当前值，更新时不调用写入服务
+struct Diagnostics
 {
-  UA_VariableAttributes vAttr = UA_VariableAttributes_default;
-  vAttr.description = UA_LOCALIZEDTEXT_ALLOC("zh-CN", desc);
-  vAttr.displayName = UA_LOCALIZEDTEXT_ALLOC("zh-CN", name);
-  vAttr.accessLevel = UA_ACCESSLEVELMASK_READ;
-  vAttr.valueRank = UA_VALUERANK_SCALAR;
-  vAttr.dataType = value.type->typeId;
-  vAttr.value = value;
+  // 累计的上游请求错误数，每次重试单独计数
+  atomic<uint64_t> upstreamErrors{0};
+  // 已获取尚未应用完成的设备页数
+  atomic<uint32_t> applyQueue{0};
+};
 
-  UA_StatusCode retval = UA_Server_addVariableNode(
-      opcServer,                                           // server
-      UA_NODEID_NUMERIC(sensorNsIndex, id),                // requestedNewNodeId
-      UA_NODEID_NUMERIC(deviceNsIndex, pid),               // parentNodeId
-      UA_NODEID_NUMERIC(0, UA_NS0ID_HASPROPERTY),          // referenceTypeId
-      UA_QUALIFIEDNAME_ALLOC(sensorNsIndex, name),         // browseName
-      UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE), // typeDefinition
-      vAttr,                                               // objectAttributes
-      NULL, NULL);
+Diagnostics diagnostics;
 
-  string status(UA_StatusCode_name(retval));
-  string msg = status + "|创建OPC传感器变量" + "[" + string(name) + "]";
-  UA_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, msg.c_str());
+// RegistryStats结构体，拉取线程每应用一页和每个周期结束时发布的不可变注册表统计，
+// 诊断变量和运行指标在其他线程通过Rcu固定一个版本读取，不访问注册表本身
+struct RegistryStats
+{
+  // 版本号，每次发布加一
+  uint64_t version = 0;
+  // 发布时的已知设备数和传感器数
+  uint32_t devices = 0;
+  uint32_t sensors = 0;
+  // 上一拉取周期的耗时毫秒数和应用的页数
+  double lastCycleMs = 0;
+  uint32_t cyclePages = 0;
+  // 最近一次全部页面都获取并应用成功的周期结束时间，尚未成功为0
+  UA_DateTime lastSuccessfulPoll = 0;
+  // 截至上一拉取周期累计的抑制写入数
+  uint64_t writesSuppressed = 0;
+};
 
-  return retval;
+// 声明已发布的注册表统计
+Rcu<RegistryStats> registryStats;
+
+// 当前线程的读者，首次调用时占用一个纪元槽，线程退出时释放
+Rcu<RegistryStats>::Reader &registry_stats_reader()
+{
+  thread_local Rcu<RegistryStats>::Reader reader(registryStats);
+  return reader;
 }
 
-// Sensor结构体
-struct Sensor
+// 以上一版本为基础生成新版本并更新设备数和传感器数，由调用方填写周期统计后发布，只在拉取线程调用
+RegistryStats *next_registry_stats()
 {
-  int sensorId;
-  string sensorName;
-  string updateDate = "0000-00-00 00:00:00";
-  UA_StatusCode status = UA_STATUSCODE_GOOD;
-};
+  const RegistryStats *last = registryStats.latest();
+  RegistryStats *stats = last != nullptr ? new RegistryStats(*last) : new RegistryStats();
+  stats->version++;
+  stats->devices = (uint32_t)registry.devices.size();
+  stats->sensors = (uint32_t)registry.sensors.size();
+  return stats;
+}
 
-// Device结构体
-struct Device
+// 距起点的秒数，用于记录耗时指标
+double seconds_since(chrono::steady_clock::time_point start)
 {
-  int deviceId;
-  string deviceNo;
-  string deviceName;
-  map<int, Sensor *> sensorList;
-};
+  return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// 声明并初始化懒加载旁路标志，为true时节点访问不触发物化也不计入访问时间
+bool lazyBypass = false;
 
-// 更新传感器数据
-void updateSensorData(Device *device, json sensorData)
+// 声明原始节点存储的getNode函数
+const UA_Node *(*nodestoreGetNode)(void *nsCtx, const UA_NodeId *nodeId) = nullptr;
+
+// 物化设备的传感器变量
+void materializeDevice(Device *device)
 {
-  // 检查传感器参数id
-  if (sensorData["id"] == nullptr)
-  {
-    UA_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "未找到传感器参数id");
-    UA_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, to_string(sensorData).c_str());
-    return;
-  }
-  // 检查传感器参数sensorName
-  if (sensorData["sensorName"] == nullptr)
-  {
-    UA_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "未找到传感器参数sensorName");
-    UA_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, to_string(sensorData).c_str());
-    return;
-  }
-  // 检查传感器参数isLine
-  if (sensorData["isLine"] == nullptr)
+  // 先标记为已物化，避免创建子节点时查询父节点再次触发物化
+  device->materialized = true;
+  bool bypass = lazyBypass;
+  lazyBypass = true;
+  for (uint32_t slot : device->sensorSlots)
   {
-    UA_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "未找到传感器参数isLine");
-    UA_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, to_string(sensorData).c_str());
-    return;
+    Sensor *sensor = &registry.sensors[slot];
+    // 跳过已创建或尚无数值的传感器
+    if (sensor->materialized || sensor->valueType == VALUE_NONE)
+    {
+      continue;
+    }
+    materializeSensor(sensor);
   }
-  // 检查传感器参数updateDate
-  if (sensorData["updateDate"] == nullptr)
+  lazyBypass = bypass;
+}
+
+// 回收设备的传感器变量，最新数值仍保留在传感器列表中
+void evictDevice(Device *device)
+{
+  bool bypass = lazyBypass;
+  lazyBypass = true;
+  for (uint32_t slot : device->sensorSlots)
   {
-    UA_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "未找到传感器参数updateDate");
-    UA_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, to_string(sensorData).c_str());
-    return;
+    Sensor *sensor = &registry.sensors[slot];
+    if (!sensor->materialized)
+    {
+      continue;
+    }
+    UA_Server_deleteNode(opcServer, UA_NODEID_NUMERIC(sensorNsIndex, sensor->sensorId), true);
+    sensor->materialized = false;
   }
-  // 检查传感器参数sensorTypeId
-  if (sensorData["sensorTypeId"] == nullptr)
+  device->materialized = false;
+  lazyBypass = bypass;
+}
+
+// 懒加载节点查询函数，在客户端浏览或读取设备时物化其传感器变量
+const UA_Node *lazyGetNode(void *nsCtx, const UA_NodeId *nodeId)
+{
+  const UA_Node *node = nodestoreGetNode(nsCtx, nodeId);
+  if (lazyBypass || nodeId->identifierType != UA_NODEIDTYPE_NUMERIC)
   {
-    UA_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "未找到传感器参数sensorTypeId");
-    UA_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, to_string(sensorData).c_str());
-    return;
+    return node;
   }
 
-  // 声明并初始化传感器数值变量
-  UA_Variant value;
-  UA_Variant_init(&value);
-
-  // 获取传感器类型ID
-  int typeId = sensorData["sensorTypeId"];
-  if (typeId == 1 || typeId == 4 || typeId == 6 || typeId == 8)
+  if (nodeId->namespaceIndex == deviceNsIndex)
   {
-    // 检查传感器参数value
-    if (sensorData["value"] == nullptr)
+    // 设备节点的上下文即设备槽位
+    Device *device = node ? contextDevice(node->head.context) : nullptr;
+    if (device == nullptr)
     {
-      UA_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "未找到传感器参数value");
-      UA_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, to_string(sensorData).c_str());
-      return;
+      return node;
     }
-    string valStr = sensorData["value"];
-    if (typeId == 1)
+    device->lastAccess = UA_DateTime_nowMonotonic();
+    if (!device->materialized)
     {
-      // 检查传感器参数decimalPlacse
-      if (sensorData["decimalPlacse"] == nullptr)
-      {
-        UA_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "未找到传感器参数decimalPlacse");
-        UA_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, to_string(sensorData).c_str());
-        return;
-      }
-      // 获取小数位长度值字符串并转化为数值
-      string lenStr = sensorData["decimalPlacse"];
-      int len = stoi(lenStr);
-      // 长度大于0是浮点数，否则就是整数
-      if (len > 0)
-      {
-        // 浮点数
-        UA_Float val = stof(valStr);
-        UA_Variant_setScalar(&value, &val, &UA_TYPES[UA_TYPES_FLOAT]);
-      }
-      else
+      materializeDevice(device);
+      // 重新获取节点，使本次浏览就能看到新增的引用
+      serverCfg->nodestore.releaseNode(nsCtx, node);
+      node = nodestoreGetNode(nsCtx, nodeId);
+    }
+  }
+  else if (nodeId->namespaceIndex == sensorNsIndex)
+  {
+    if (node != nullptr)
+    {
+      // 传感器节点的上下文即所属设备槽位
+      Device *device = contextDevice(node->head.context);
+      if (device != nullptr)
       {
-        // 整数
-        UA_IntegerId val = stoi(valStr);
-        UA_Variant_setScalar(&value, &val, &UA_TYPES[UA_TYPES_INTEGERID]);
+        device->lastAccess = UA_DateTime_nowMonotonic();
       }
+      return node;
     }
-    else
+    // 按ID直接访问尚未物化的传感器时，通过全局索引找到所属设备并物化
+    Sensor *sensor = registry.findSensor(nodeId->identifier.numeric);
+    if (sensor != nullptr && !registry.devices[sensor->deviceSlot].materialized)
     {
-      // 字符串
-      UA_String val = UA_String_fromChars(valStr.c_str());
-      UA_Variant_setScalar(&value, &val, &UA_TYPES[UA_TYPES_STRING]);
+      Device *device = &registry.devices[sensor->deviceSlot];
+      device->lastAccess = UA_DateTime_nowMonotonic();
+      materializeDevice(device);
+      node = nodestoreGetNode(nsCtx, nodeId);
     }
   }
-  else if (typeId == 2 || typeId == 5)
+  return node;
+}
+
+// 懒加载节点回收回调函数
+void evictCallback(UA_Server *, void *)
+{
+  UA_DateTime idle = (UA_DateTime)cfg.lazyIdleSec * UA_DATETIME_SEC;
+  UA_DateTime now = UA_DateTime_nowMonotonic();
+  for (Device &device : registry.devices)
   {
-    // 检查传感器参数switcher
-    if (sensorData["switcher"] == nullptr)
+    if (device.materialized && now - device.lastAccess > idle)
     {
-      UA_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "未找到传感器参数switcher");
-      UA_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, to_string(sensorData).c_str());
-      return;
+      evictDevice(&device);
     }
-    // 将开关转换为布尔值
-    int switcher = sensorData["switcher"];
-    UA_Boolean val = switcher > 0;
-    UA_Variant_setScalar(&value, &val, &UA_TYPES[UA_TYPES_BOOLEAN]);
-  }
-  else
-  {
-    string msg = "不支持的传感器类型ID: " + to_string(typeId);
-    UA_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, msg.c_str());
-    return;
   }
+}
 
-  // 声明并初始化传感器对象
-  Sensor *sensor = nullptr;
-  // 通过传感器参数id查找传感器
-  auto sensorIter = device->sensorList.find(sensorData["id"]);
-  if (sensorIter == device->sensorList.end())
+// 获取进程常驻内存字节数
+size_t residentMemory()
+{
+#if defined(_WIN16) || defined(_WIN32) || defined(_WIN64)
+  PROCESS_MEMORY_COUNTERS pmc;
+  if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
   {
-    // 新建传感器
-    sensor = new Sensor;
-    sensor->sensorId = sensorData["id"];
-    sensor->sensorName = sensorData["sensorName"];
-
-    // 加入传感器列表
-    device->sensorList[sensorData["id"]] = sensor;
-
-    // 创建OPC传感器变量
-    UA_StatusCode retval = createSensorVariable(
-        sensor->sensorId, device->deviceId,
-        sensor->sensorName.c_str(), sensor->sensorName.c_str(), value);
-    // 如果创建OPC传感器变量失败，则返回
-    if (retval != UA_STATUSCODE_GOOD)
-    {
-      return;
-    }
+    return pmc.WorkingSetSize;
   }
-  else
+  return 0;
+#else
+  size_t pages = 0, rss = 0;
+  ifstream statm("/proc/self/statm");
+  statm >> pages >> rss;
+  return rss * (size_t)sysconf(_SC_PAGESIZE);
+#endif
+}
+
+// 获取进程已使用的CPU时间，单位毫秒
+long long processCpuTime()
+{
+#if defined(_WIN16) || defined(_WIN32) || defined(_WIN64)
+  FILETIME creation, exit, kernel, user;
+  if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
   {
-    // 赋值传感器
-    sensor = sensorIter->second;
+    return 0;
   }
+  ULARGE_INTEGER k, u;
+  k.LowPart = kernel.dwLowDateTime;
+  k.HighPart = kernel.dwHighDateTime;
+  u.LowPart = user.dwLowDateTime;
+  u.HighPart = user.dwHighDateTime;
+  return (long long)((k.QuadPart + u.QuadPart) / 10000);
+#else
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return (long long)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000 +
+         (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000;
+#endif
+}
 
-  // 获取是否在线
-  int isLineValue = sensorData["isLine"];
-  // 转换为传感器状态
-  sensor->status = isLineValue > 0 ? UA_STATUSCODE_GOOD : UA_STATUSCODE_BAD;
-
-  // 获取更新时间字符串
-  string updateDate = sensorData["updateDate"];
-  // 时间有变化则更新
-  if (sensor->updateDate != updateDate)
+// 输出常驻节点统计
+void logNodeStats()
+{
+  size_t resident = 0;
+  for (Sensor &sensor : registry.sensors)
   {
-    sensor->updateDate = updateDate;
-    // 更新变量
-    updateVariable(sensor->sensorId, sensor->status, value);
+    resident += sensor.materialized ? 1 : 0;
   }
+  OPC_LOG_INFO(&serverCfg->logger, UA_LOGCATEGORY_SERVER,
+              "节点统计|懒加载: %s, 设备: %zu, 传感器: %zu, 常驻传感器节点: %zu, 常驻内存: %zuKB",
+              cfg.lazyNodes ? "开启" : "关闭", registry.devices.size(), registry.sensors.size(), resident,
+              residentMemory() / 1024);
+  OPC_LOG_INFO(&serverCfg->logger, UA_LOGCATEGORY_SERVER,
+              "传感器记录|热数据: %zuB, 冷数据: %zuB, 每10万传感器热数据: %zuKB",
+              registry.sensors.capacity() * sizeof(Sensor),
+              registry.sensorMetas.capacity() * sizeof(SensorMeta),
+              100000 * sizeof(Sensor) / 1024);
+  OPC_LOG_INFO(&serverCfg->logger, UA_LOGCATEGORY_SERVER,
+              "名称池|名称: %zu, 驻留前: %zuB, 驻留后: %zuB, 节省: %zuB",
+              namePool.strings.size(), namePool.requestedBytes, namePool.storedBytes,
+              namePool.requestedBytes - namePool.storedBytes);
 }
 
-// 声明文件夹空间索引
-UA_UInt16 folderNsIndex;
+// 快照文件格式版本，记录布局变化时递增
+const uint32_t SNAPSHOT_VERSION = 1;
 
-// 创建OPC设备对象
-UA_StatusCode createDeviceObject(int id, int pid, const char *name, const char *desc)
+// SnapshotHeader结构体，其后依次为设备、传感器记录、传感器名称、字符串数值和字符串区
+struct SnapshotHeader
 {
-  UA_ObjectAttributes oAttr = UA_ObjectAttributes_default;
-  oAttr.description = UA_LOCALIZEDTEXT_ALLOC("zh-CN", desc);
-  oAttr.displayName = UA_LOCALIZEDTEXT_ALLOC("zh-CN", name);
+  char magic[8];
+  uint32_t version;
+  uint32_t sensorSize;
+  uint64_t deviceCount;
+  uint64_t sensorCount;
+  uint64_t textCount;
+  uint64_t stringsSize;
+};
 
-  UA_StatusCode retval = UA_Server_addObjectNode(
-      opcServer,                                     // server
-      UA_NODEID_NUMERIC(deviceNsIndex, id),          // requestedNewNodeId
-      UA_NODEID_NUMERIC(folderNsIndex, pid),         // parentNodeId
-      UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT),   // referenceTypeId
-      UA_QUALIFIEDNAME_ALLOC(deviceNsIndex, name),   // browseName
-      UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE), // typeDefinition
-      oAttr,                                         // objectAttributes
-      NULL, NULL);
+// SnapshotString结构体，字符串在字符串区中的位置
+struct SnapshotString
+{
+  uint32_t offset;
+  uint32_t length;
+};
 
-  string status(UA_StatusCode_name(retval));
-  string msg = status + "|创建OPC设备对象" + "[" + string(name) + "]";
-  UA_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, msg.c_str());
+// SnapshotDevice结构体
+struct SnapshotDevice
+{
+  int32_t deviceId;
+  SnapshotString deviceNo;
+  SnapshotString deviceName;
+};
 
-  return retval;
+// 计算快照各区域的总大小
+size_t snapshotSize(const SnapshotHeader &header)
+{
+  return sizeof(SnapshotHeader) + header.deviceCount * sizeof(SnapshotDevice) +
+         header.sensorCount * (sizeof(Sensor) + sizeof(SnapshotString)) +
+         header.textCount * sizeof(SnapshotString) + header.stringsSize;
 }
 
-// 声明并初始化文件夹ID
-int folderId = 1;
-
-// 声明设备列表
-map<int, Device *> deviceList;
-
-// 更新设备数据
-void updateDeviceData(json deviceData)
+// 将注册表写入快照文件，先写临时文件再原子替换
+bool save_snapshot()
 {
-  // 检查设备参数id
-  if (deviceData["id"] == nullptr)
-  {
-    UA_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "未找到设备参数id");
-    UA_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, to_string(deviceData).c_str());
-    return;
-  }
-  // 检查设备参数deviceName
-  if (deviceData["deviceName"] == nullptr)
-  {
-    UA_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "未找到设备参数deviceName");
-    UA_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, to_string(deviceData).c_str());
-    return;
-  }
-  // 检查设备参数deviceNo
-  if (deviceData["deviceNo"] == nullptr)
+  // 汇总字符串区，驻留的名称只写一次
+  string strings;
+  unordered_map<const string *, SnapshotString> names;
+  auto addString = [&strings](const string &str)
   {
-    UA_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "未找到设备参数deviceNo");
-    UA_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, to_string(deviceData).c_str());
-    return;
-  }
-
-  // 声明并初始化设备对象
-  Device *device = nullptr;
-  // 通过设备参数id查找设备
-  auto deviceIter = deviceList.find(deviceData["id"]);
-  if (deviceIter == deviceList.end())
+    SnapshotString ref = {(uint32_t)strings.size(), (uint32_t)str.size()};
+    strings += str;
+    return ref;
+  };
+  auto addName = [&names, &addString](const string *name)
   {
-    // 新建设备
-    device = new Device;
-    device->deviceId = deviceData["id"];
-    device->deviceNo = deviceData["deviceNo"];
-    device->deviceName = deviceData["deviceName"];
-    // 如果是默认设备名称就加上设备ID
-    if (device->deviceName == "4G压力表")
-    {
-      device->deviceName += "(" + to_string(device->deviceId) + ")";
-    }
-
-    // 加入设备列表
-    deviceList[deviceData["id"]] = device;
-
-    // 创建OPC设备对象
-    UA_StatusCode retval = createDeviceObject(device->deviceId, folderId, device->deviceName.c_str(), device->deviceNo.c_str());
-    // 如果创建OPC设备对象失败，则返回
-    if (retval != UA_STATUSCODE_GOOD)
+    auto iter = names.find(name);
+    if (iter == names.end())
     {
-      return;
+      iter = names.emplace(name, addString(*name)).first;
     }
-  }
-  else
-  {
-    // 赋值设备
-    device = deviceIter->second;
-  }
+    return iter->second;
+  };
 
-  // 检查设备参数sensorsList
-  if (deviceData["sensorsList"] == nullptr)
+  vector<SnapshotDevice> devices;
+  devices.reserve(registry.devices.size());
+  for (Device &device : registry.devices)
   {
-    UA_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "未找到设备参数sensorsList");
-    UA_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, to_string(deviceData).c_str());
-    return;
+    devices.push_back(SnapshotDevice{device.deviceId, addString(device.deviceNo), addName(device.deviceName)});
   }
-  // 检查设备参数sensorsList是否为数组
-  if (!deviceData["sensorsList"].is_array())
+  vector<SnapshotString> sensorNames;
+  sensorNames.reserve(registry.sensorMetas.size());
+  for (SensorMeta &meta : registry.sensorMetas)
   {
-    UA_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "sensorsList不是有效的数组类型");
-    UA_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, to_string(deviceData["sensorsList"]).c_str());
-    return;
+    sensorNames.push_back(addName(meta.sensorName));
   }
-  // 遍历sensorsList数组
-  for (int j = 0; j < deviceData["sensorsList"].size(); j++)
+  vector<SnapshotString> texts;
+  texts.reserve(registry.texts.size());
+  for (string &text : registry.texts)
   {
-    // 声明并赋值传感器JSON数据
-    json sensorData = deviceData["sensorsList"][j];
-    // 更新传感器数据
-    updateSensorData(device, sensorData);
+    texts.push_back(addString(text));
   }
-}
-
-// Config结构体
-struct Config
-{
-  string username;
-  string password;
-  string clientId;
-  string secret;
-  int userId;
-};
-
-// 声明配置变量
-Config cfg;
-
-// 声明并初始化请求域名
-string url = "https://app.dtuip.com";
-
-// 声明并初始化token
-string token = "";
-
-// 声明并初始化失效时间戳
-time_t expireTs = time(nullptr);
-
-// 获取token
-bool get_token()
-{
-  // 创建HTTP客户端
-  Client cli(url);
-
-  // 配置basic auth
-  cli.set_basic_auth(cfg.clientId, cfg.secret);
-
-  // 配置请求参数
-  Params params{
-      {"grant_type", "password"},
-      {"username", cfg.username},
-      {"password", cfg.password},
-  };
 
-  // 发送HTTP请求
-  Result res = cli.Post("/oauth/token", params);
-
-  // 检查请求结果大小，为空则输出错误
-  if (res->body.size())
+  SnapshotHeader header = {{'O', 'P', 'C', 'S', 'N', 'A', 'P', 0}, SNAPSHOT_VERSION, sizeof(Sensor),
+                           devices.size(), registry.sensors.size(), texts.size(), strings.size()};
+  string tmpFile = cfg.snapshotFile + ".tmp";
   {
-    // 解析请求结果
-    json data = json::parse(res->body);
-    if (data == nullptr)
-    {
-      UA_LOG_ERROR(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "解析json数据失败");
-      UA_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, res->body.c_str());
-      return false;
-    }
-    // 检查返回参数userId
-    if (data["userId"] == nullptr)
+    MappedFile file;
+    if (!file.create(tmpFile.c_str(), snapshotSize(header)))
     {
-      UA_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "未获取到userId参数");
-      UA_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, res->body.c_str());
+      OPC_LOG_ERROR(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "创建快照文件失败: %s", tmpFile.c_str());
       return false;
     }
-    // 检查返回参数expires_in
-    if (data["expires_in"] == nullptr)
+    char *p = (char *)file.data;
+    auto put = [&p](const void *src, size_t size)
     {
-      UA_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "未获取到expires_in参数");
-      UA_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, res->body.c_str());
-      return false;
-    }
-    // 检查返回参数access_token
-    if (data["access_token"] == nullptr)
+      if (size > 0)
+      {
+        memcpy(p, src, size);
+        p += size;
+      }
+    };
+    put(&header, sizeof(header));
+    put(devices.data(), devices.size() * sizeof(SnapshotDevice));
+    put(registry.sensors.data(), registry.sensors.size() * sizeof(Sensor));
+    put(sensorNames.data(), sensorNames.size() * sizeof(SnapshotString));
+    put(texts.data(), texts.size() * sizeof(SnapshotString));
+    put(strings.data(), strings.size());
+    if (!file.flush())
     {
-      UA_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "未获取到access_token参数");
-      UA_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, res->body.c_str());
+      OPC_LOG_ERROR(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "写入快照文件失败: %s", tmpFile.c_str());
       return false;
     }
-    // 设置用户ID
-    cfg.userId = data["userId"];
-
-    // 设置失效时间戳
-    int expireIn = data["expires_in"];
-    expireTs = time(nullptr) + expireIn;
-
-    // 设置token
-    token = data["access_token"];
   }
-  else
+  if (!replaceFile(tmpFile.c_str(), cfg.snapshotFile.c_str()))
   {
-    UA_LOG_ERROR(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "获取token失败");
-    UA_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, to_string(res.error()).c_str());
+    OPC_LOG_ERROR(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "替换快照文件失败: %s", cfg.snapshotFile.c_str());
     return false;
   }
   return true;
 }
 
-// 获取设备列表数据
-void get_device_datas(int page, int size)
+// 从快照文件恢复注册表，应在首次拉取数据前调用
+bool load_snapshot()
 {
-  // 获取当前时间戳
-  time_t currentTs = time(nullptr);
-  // 如果token为空，或当前时间戳大于或等于失效时间戳，则重新获取token
-  if (token == "" || currentTs >= expireTs)
+  MappedFile file;
+  if (!file.openRead(cfg.snapshotFile.c_str()))
   {
-    // 获取token
-    bool status = get_token();
-    // 如果获取token失败，则返回
-    if (!status)
-    {
-      return;
-    }
+    OPC_LOG_INFO(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "未找到快照文件: %s", cfg.snapshotFile.c_str());
+    return false;
   }
 
-  // 创建HTTP客户端
-  Client cli(url);
-
-  // 配置bearer auth
-  cli.set_bearer_token_auth(token);
+  // 检查文件头和各区域大小
+  SnapshotHeader header;
+  if (file.size < sizeof(header))
+  {
+    OPC_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "快照文件不完整");
+    return false;
+  }
+  memcpy(&header, file.data, sizeof(header));
+  if (memcmp(header.magic, "OPCSNAP", 8) != 0 || header.version != SNAPSHOT_VERSION ||
+      header.sensorSize != sizeof(Sensor) || header.deviceCount > UINT32_MAX || header.sensorCount > UINT32_MAX)
+  {
+    OPC_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "快照文件版本不匹配，忽略快照");
+    return false;
+  }
+  if (snapshotSize(header) != file.size)
+  {
+    OPC_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "快照文件不完整");
+    return false;
+  }
 
-  // 创建header数据
-  Headers header = {
-      {"tlinkAppId", cfg.clientId},
+  const char *p = (const char *)file.data + sizeof(header);
+  const char *devices = p;
+  const char *sensors = devices + header.deviceCount * sizeof(SnapshotDevice);
+  const char *sensorNames = sensors + header.sensorCount * sizeof(Sensor);
+  const char *texts = sensorNames + header.sensorCount * sizeof(SnapshotString);
+  const char *strings = texts + header.textCount * sizeof(SnapshotString);
+  bool valid = true;
+  auto readString = [&](SnapshotString ref)
+  {
+    if ((uint64_t)ref.offset + ref.length > header.stringsSize)
+    {
+      valid = false;
+      return string();
+    }
+    return string(strings + ref.offset, ref.length);
   };
-
-  // 创建POST数据
-  json jsonData = {
-      {"userId", cfg.userId},
-      {"currPage", page},
-      {"pageSize", size},
+  auto getString = [&](const char *base, size_t index)
+  {
+    SnapshotString ref;
+    memcpy(&ref, base + index * sizeof(SnapshotString), sizeof(ref));
+    return readString(ref);
   };
 
-  // 生成POST的body数据
-  string body = jsonData.dump();
-
-  // 设定内容类型
-  string contentType = "application/json";
+  // 恢复字符串数值
+  registry.texts.resize(header.textCount);
+  vector<bool> usedTexts(header.textCount, false);
+  for (size_t i = 0; i < header.textCount; i++)
+  {
+    registry.texts[i] = getString(texts, i);
+  }
 
-  // 发送HTTP请求
-  Result res = cli.Post("/api/device/getDeviceSensorDatas", header, body, contentType);
+  // 恢复设备
+  for (size_t i = 0; i < header.deviceCount && valid; i++)
+  {
+    SnapshotDevice record;
+    memcpy(&record, devices + i * sizeof(SnapshotDevice), sizeof(record));
+    Device *device = registry.addDevice(record.deviceId);
+    device->deviceNo = readString(record.deviceNo);
+    device->deviceName = namePool.intern(readString(record.deviceName));
+    device->materialized = !cfg.lazyNodes;
+  }
 
-  // 检查请求结果大小，为空则输出错误
-  if (res->body.size())
+  // 恢复传感器，槽位与写入时一致
+  for (size_t i = 0; i < header.sensorCount && valid; i++)
   {
-    // 解析请求结果
-    json data = json::parse(res->body);
-    if (data == nullptr)
+    Sensor record;
+    memcpy(&record, sensors + i * sizeof(Sensor), sizeof(record));
+    if (record.deviceSlot >= registry.devices.size() ||
+        (record.valueType == VALUE_STRING && record.value.text >= header.textCount))
     {
-      UA_LOG_ERROR(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "解析json数据失败");
-      UA_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, res->body.c_str());
-      return;
+      valid = false;
+      break;
     }
-    // 检查返回参数flag
-    if (data["flag"] == nullptr)
+    Device *device = &registry.devices[record.deviceSlot];
+    Sensor *sensor = registry.addSensor(device, record.sensorId, namePool.intern(getString(sensorNames, i)));
+    *sensor = record;
+    sensor->materialized = false;
+    if (record.valueType == VALUE_STRING)
     {
-      UA_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "未获取到flag参数");
-      UA_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, res->body.c_str());
-      return;
+      usedTexts[record.value.text] = true;
     }
-    // 赋值并检查返回标示
-    string flag = data["flag"];
-    if (flag != "00")
+  }
+  if (!valid)
+  {
+    OPC_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "快照文件数据损坏，忽略快照");
+    registry.clear();
+    return false;
+  }
+  for (size_t i = 0; i < usedTexts.size(); i++)
+  {
+    if (!usedTexts[i])
     {
-      UA_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "获取设备列表数据失败");
-      UA_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, to_string(data["msg"]).c_str());
-      return;
+      registry.freeTexts.push_back((uint32_t)i);
     }
-    // 检查返回参数rowCount
-    if (data["rowCount"] == nullptr)
+  }
+  return true;
+}
+
+// 回放变更日志中比快照更新的传感器数值，返回应用的记录数
+size_t replay_journal()
+{
+  size_t applied = 0;
+  size_t validBytes = 0;
+  size_t fileBytes = 0;
+  size_t count = Journal::replay(cfg.journalFile.c_str(), [&applied](const char *data, uint32_t length)
+  {
+    JournalRecord record;
+    if (length < sizeof(record))
     {
-      UA_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "未获取到rowCount参数");
-      UA_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, res->body.c_str());
       return;
     }
-    // 检查返回参数dataList
-    if (data["dataList"] == nullptr)
+    memcpy(&record, data, sizeof(record));
+    // 快照之后新增的传感器不在注册表中，等待下次拉取重新创建
+    if (record.slot >= registry.sensors.size() || length != sizeof(record) + record.textLength)
     {
-      UA_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "未获取到dataList参数");
-      UA_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, res->body.c_str());
       return;
     }
-    // 检查返回参数dataList是否为数组
-    if (!data["dataList"].is_array())
+    Sensor *sensor = &registry.sensors[record.slot];
+    if (sensor->sensorId != record.sensorId || record.updateTs <= sensor->updateTs)
     {
-      UA_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "dataList不是有效的数组类型");
-      UA_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, to_string(data["dataList"]).c_str());
       return;
     }
-    int total = data["rowCount"];
-    // 遍历dataList数组
-    for (int i = 0; i < data["dataList"].size(); i++)
+    SensorValue value;
+    value.type = record.valueType;
+    value.number = record.number;
+    value.text.assign(data + sizeof(record), record.textLength);
+    sensor->status = record.status;
+    sensor->updateTs = record.updateTs;
+    storeSensorValue(sensor, value);
+    applied++;
+  }, &validBytes, &fileBytes);
+  OPC_LOG_INFO(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "回放日志|记录: %zu, 应用: %zu", count, applied);
+
+  // 截断崩溃时写入不完整的尾部，之后追加的记录才能在下次回放时读到
+  if (fileBytes > validBytes)
+  {
+    size_t torn = fileBytes - validBytes;
+    if (Journal::truncateTo(cfg.journalFile.c_str(), validBytes))
     {
-      // 声明并赋值设备JSON数据
-      json deviceData = data["dataList"][i];
-      // 更新设备数据
-      updateDeviceData(deviceData);
+      OPC_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "回放日志|截断不完整的尾部: %zu字节", torn);
     }
-
-    // 判断当前页数据是否已经达到指定大小，并且总数据量大于当前页数
-    // 如果满足条件，则说明还需要获取下一页数据
-    if (data["dataList"].size() == size && page * size < total)
+    else
     {
-      get_device_datas(page + 1, size);
+      OPC_LOG_ERROR(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "截断变更日志失败: %s", cfg.journalFile.c_str());
     }
   }
-  else
-  {
-    UA_LOG_ERROR(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "获取设备列表数据失败");
-    UA_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, to_string(res.error()).c_str());
-    return;
-  }
+  return applied;
 }
 
-// API请求回调函数
-void httpCallback(UA_Server *server, void *data)
+// 按注册表重建地址空间
+void rebuild_address_space()
 {
-  // 获取设备列表数据
-  get_device_datas(1, 100);
+  lazyBypass = true;
+  for (Device &device : registry.devices)
+  {
+    UA_StatusCode retval = createDeviceObject(device.deviceId, folderId, device.deviceName->c_str(), device.deviceNo.c_str(), deviceContext(&device));
+    if (retval != UA_STATUSCODE_GOOD || !device.materialized)
+    {
+      continue;
+    }
+    for (uint32_t slot : device.sensorSlots)
+    {
+      if (registry.sensors[slot].valueType != VALUE_NONE)
+      {
+        materializeSensor(&registry.sensors[slot]);
+      }
+    }
+  }
+  lazyBypass = false;
 }
 
-// 时间转换函数
-UA_DateTime convertToDateTime(UA_UInt64 expectedTime)
-{
-  UA_UInt64 interval = (UA_UInt64)(expectedTime * UA_DATETIME_MSEC);
-  UA_DateTime nextTime = UA_DateTime_nowMonotonic() + (UA_DateTime)interval;
+// 停止请求标志和收到停止信号的单调时间，由信号处理函数设置，拉取流程在各阶段检查
+atomic<bool> stopRequested{false};
+atomic<UA_DateTime> stopRequestedAt{0};
 
-  return nextTime;
-}
+// 正在进行阻塞请求的HTTP客户端，拉取和token刷新线程各自登记，停止时由监视线程中断其连接
+mutex fetchMutex;
+vector<Client *> fetchClients;
 
-// 创建OPC文件夹对象
-UA_StatusCode createFolderObject(int id, int pid, const char *name, const char *desc)
+// FetchScope结构体，在作用域内登记进行阻塞请求的客户端
+struct FetchScope
 {
-  UA_ObjectAttributes oAttr = UA_ObjectAttributes_default;
-  oAttr.description = UA_LOCALIZEDTEXT_ALLOC("zh-CN", desc);
-  oAttr.displayName = UA_LOCALIZEDTEXT_ALLOC("zh-CN", name);
+  Client *client;
 
-  UA_UInt16 pNsIndex = folderNsIndex++;
-  if (pid == UA_NS0ID_OBJECTSFOLDER)
+  FetchScope(Client &cli) : client(&cli)
   {
-    pNsIndex = 0;
+    lock_guard<mutex> guard(fetchMutex);
+    fetchClients.push_back(client);
   }
 
-  UA_StatusCode retval = UA_Server_addObjectNode(
-      opcServer,                                   // server
-      UA_NODEID_NUMERIC(folderNsIndex, id),        // requestedNewNodeId
-      UA_NODEID_NUMERIC(pNsIndex, pid),            // parentNodeId
-      UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT), // referenceTypeId
-      UA_QUALIFIEDNAME_ALLOC(folderNsIndex, name), // browseName
-      UA_NODEID_NUMERIC(0, UA_NS0ID_FOLDERTYPE),   // typeDefinition
-      oAttr,                                       // objectAttributes
-      NULL, NULL);
-  string status(UA_StatusCode_name(retval));
-  string msg = status + "|创建OPC文件夹对象" + "[" + string(name) + "]";
-  UA_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, msg.c_str());
+  ~FetchScope()
+  {
+    lock_guard<mutex> guard(fetchMutex);
+    fetchClients.erase(find(fetchClients.begin(), fetchClients.end(), client));
+  }
+};
 
-  return retval;
+// 中断进行中的阻塞请求，请求随即以连接错误返回
+void cancel_fetch()
+{
+  lock_guard<mutex> guard(fetchMutex);
+  for (Client *client : fetchClients)
+  {
+    client->stop();
+  }
 }
 
-// 声明并初始化运行状态
-UA_Boolean running = true;
-
-// 信号处理函数
-void signalHandler(int sig)
+// 距停止期限的剩余毫秒数，未收到停止信号时不限
+long long shutdown_remaining_ms()
 {
-  // 运行状态为false
-  running = false;
+  if (!stopRequested)
+  {
+    return LLONG_MAX;
+  }
+  return cfg.shutdownTimeoutMs - (UA_DateTime_nowMonotonic() - stopRequestedAt) / UA_DATETIME_MSEC;
 }
 
-// 声明并初始化文件夹名称
-string folderName = "拓普瑞";
+// 上游接口熔断器和重试计数
+CircuitBreaker upstreamBreaker;
+atomic<size_t> upstreamRetries{0};
+atomic<size_t> upstreamFailures{0};
 
-// OPC-UA服务器
-int boot_server(UA_LogLevel log_level)
+// 响应是否可重试，传输错误（状态为0）、限流和服务端错误可重试，其他状态说明上游可用
+bool retryable_status(int status)
 {
-  // 注册信号处理函数，用于处理SIGINT和SIGTERM信号
-  signal(SIGINT, signalHandler);
-  signal(SIGTERM, signalHandler);
+  return status == 0 || status == 429 || status >= 500;
+}
 
-  // 创建OPC-UA服务器对象
-  opcServer = UA_Server_new();
+// 第attempt次重试前的等待毫秒数，指数退避加全抖动，多个实例不会同时重试
+int retry_delay_ms(int attempt)
+{
+  static thread_local mt19937 rng(random_device{}());
+  long long cap = min((long long)cfg.retryBaseMs << min(attempt, 20), (long long)cfg.retryMaxMs);
+  return uniform_int_distribution<int>(0, (int)max(cap, 0LL))(rng);
+}
 
-  // 设置OPC-UA服务器配置
+// 记录一次上游请求的接收字节数和错误分类，每次重试单独记录
+void record_upstream_attempt(int status, size_t bytes)
+{
+  metrics.add(metric.bytesReceived, bytes);
+  if (status == 0 || status >= 400)
+  {
+    diagnostics.upstreamErrors.fetch_add(1, memory_order_relaxed);
+  }
+  if (status == 0)
+  {
+    metrics.add(metric.upstreamErrors[UPSTREAM_TRANSPORT]);
+  }
+  else if (status == 429)
+  {
+    metrics.add(metric.upstreamErrors[UPSTREAM_THROTTLED]);
+  }
+  else if (status >= 500)
+  {
+    metrics.add(metric.upstreamErrors[UPSTREAM_SERVER]);
+  }
+  else if (status >= 400)
+  {
+    metrics.add(metric.upstreamErrors[UPSTREAM_CLIENT]);
+  }
+}
+
+// 上游请求结束，按最终结果更新熔断器，停止时被中断的请求不计入
+void record_upstream_result(int status)
+{
+  if (stopRequested)
+  {
+    return;
+  }
+  if (retryable_status(status))
+  {
+    upstreamFailures++;
+    upstreamBreaker.onFailure();
+  }
+  else
+  {
+    upstreamBreaker.onSuccess();
+  }
+}
+
+// 设置阻塞客户端的连接、读取和写入超时
+void set_client_timeouts(Client &cli)
+{
+  time_t sec = cfg.httpTimeoutMs / 1000;
+  time_t usec = cfg.httpTimeoutMs % 1000 * 1000;
+  cli.set_connection_timeout(sec, usec);
+  cli.set_read_timeout(sec, usec);
+  cli.set_write_timeout(sec, usec);
+}
+
+// 带重试和熔断的阻塞上游请求，send发出一次请求
+// 熔断器打开时不发请求，返回Error::Canceled；重试等待期间收到停止信号则不再重试
+Result upstream_call(const function<Result()> &send)
+{
+  if (!upstreamBreaker.allow())
+  {
+    OPC_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "上游熔断中，跳过请求");
+    return Result(nullptr, Error::Canceled);
+  }
+  Result res = send();
+  record_upstream_attempt(res ? res->status : 0, res ? res->body.size() : 0);
+  for (int attempt = 0; attempt < cfg.retryMax && !stopRequested && retryable_status(res ? res->status : 0); attempt++)
+  {
+    upstreamRetries++;
+    int delay = retry_delay_ms(attempt);
+    for (int waited = 0; waited < delay && !stopRequested; waited += 20)
+    {
+      this_thread::sleep_for(chrono::milliseconds(min(20, delay - waited)));
+    }
+    if (stopRequested)
+    {
+      break;
+    }
+    res = send();
+    record_upstream_attempt(res ? res->status : 0, res ? res->body.size() : 0);
+  }
+  record_upstream_result(res ? res->status : 0);
+  return res;
+}
+
+// 声明并初始化请求域名
+string url = "https://app.dtuip.com";
+
+// Credential结构体，一次获取的token，发布后不再修改
+struct Credential
+{
+  string accessToken;
+  // 上游返回的refresh token，没有则为空
+  string refreshToken;
+  // 用户ID，设备列表请求需要
+  int userId = 0;
+  // 获取时间戳
+  time_t issuedTs = 0;
+  // 失效时间戳
+  time_t expireTs = 0;
+};
+
+// 当前token，后台刷新线程获取新token后整体替换，拉取流程取得副本后使用，不会读到半更新的token
+mutex credentialMutex;
+shared_ptr<const Credential> credential = make_shared<Credential>();
+
+// 取得当前token
+shared_ptr<const Credential> current_credential()
+{
+  lock_guard<mutex> guard(credentialMutex);
+  return credential;
+}
+
+// 当前token是否可用
+bool credential_valid(const Credential &item)
+{
+  return !item.accessToken.empty() && time(nullptr) < item.expireTs;
+}
+
+// 累计获取token的次数
+atomic<size_t> tokenRefreshes{0};
+
+// 后台刷新线程的唤醒条件，token被拒绝时提前唤醒
+mutex refreshMutex;
+condition_variable refreshWake;
+bool refreshStop = false;
+
+// 同一时间只写入一次token状态文件
+mutex tokenFileMutex;
+
+// 保存token状态文件，文件只允许所有者读写，先写临时文件再替换
+bool save_token_state(const Credential &item)
+{
+  json data = {
+      {"apiUrl", url},
+      {"username", cfg.username},
+      {"accessToken", item.accessToken},
+      {"refreshToken", item.refreshToken},
+      {"issuedTs", item.issuedTs},
+      {"expireTs", item.expireTs},
+      {"userId", item.userId},
+  };
+  string text = data.dump();
+  string tmpFile = cfg.tokenFile + ".tmp";
+  lock_guard<mutex> guard(tokenFileMutex);
+#if defined(_WIN16) || defined(_WIN32) || defined(_WIN64)
+  // Windows下文件继承所在目录的访问控制
+  ofstream file(tmpFile, ios::binary | ios::trunc);
+  file << text;
+  bool ok = file.good();
+  file.close();
+#else
+  // 临时文件可能是之前留下的，重新设置为只允许所有者读写
+  int fd = ::open(tmpFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+  bool ok = fd >= 0 && fchmod(fd, 0600) == 0 && write(fd, text.data(), text.size()) == (ssize_t)text.size() && fsync(fd) == 0;
+  if (fd >= 0)
+  {
+    close(fd);
+  }
+#endif
+  if (!ok || !replaceFile(tmpFile.c_str(), cfg.tokenFile.c_str()))
+  {
+    OPC_LOG_ERROR(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "写入token状态文件失败: %s", cfg.tokenFile.c_str());
+    return false;
+  }
+  return true;
+}
+
+// 启动时读取token状态文件，接口地址和用户名一致时恢复token，access token失效时仍保留refresh token
+bool load_token_state()
+{
+  ifstream file(cfg.tokenFile);
+  if (!file.is_open())
+  {
+    return false;
+  }
+  json data = json::parse(file, nullptr, false);
+  if (data.is_discarded() || !data["accessToken"].is_string() || !data["refreshToken"].is_string() ||
+      !data["expireTs"].is_number() || !data["issuedTs"].is_number() || !data["userId"].is_number())
+  {
+    OPC_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "token状态文件格式错误: %s", cfg.tokenFile.c_str());
+    return false;
+  }
+  if (data["apiUrl"] != url || data["username"] != cfg.username)
+  {
+    OPC_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "token状态文件的接口地址或用户名与配置不一致，不使用");
+    return false;
+  }
+  shared_ptr<Credential> item = make_shared<Credential>();
+  item->accessToken = data["accessToken"];
+  item->refreshToken = data["refreshToken"];
+  item->issuedTs = data["issuedTs"];
+  item->expireTs = data["expireTs"];
+  item->userId = data["userId"];
+  {
+    lock_guard<mutex> guard(credentialMutex);
+    credential = item;
+  }
+  OPC_LOG_INFO(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "恢复token|剩余有效秒数: %lld, refresh token: %s",
+              (long long)max<time_t>(item->expireTs - time(nullptr), 0), item->refreshToken.empty() ? "无" : "有");
+  return true;
+}
+
+// 解析token接口的返回数据并保存token
+bool apply_token(const string &body)
+{
+  // 解析请求结果，格式错误时不抛出异常
+  json data = json::parse(body, nullptr, false);
+  if (data.is_discarded() || !data.is_object())
+  {
+    OPC_LOG_ERROR(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "解析json数据失败");
+    OPC_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "%s", body.c_str());
+    return false;
+  }
+  // 检查返回参数userId
+  if (!data["userId"].is_number())
+  {
+    OPC_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "未获取到userId参数");
+    OPC_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "%s", body.c_str());
+    return false;
+  }
+  // 检查返回参数expires_in
+  if (!data["expires_in"].is_number())
+  {
+    OPC_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "未获取到expires_in参数");
+    OPC_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "%s", body.c_str());
+    return false;
+  }
+  // 检查返回参数access_token
+  if (!data["access_token"].is_string())
+  {
+    OPC_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "未获取到access_token参数");
+    OPC_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "%s", body.c_str());
+    return false;
+  }
+  // 生成新token，设置用户ID和失效时间戳
+  shared_ptr<Credential> item = make_shared<Credential>();
+  item->userId = data["userId"];
+  item->issuedTs = time(nullptr);
+  int expireIn = data["expires_in"];
+  item->expireTs = item->issuedTs + expireIn;
+  item->accessToken = data["access_token"];
+  // 刷新授权可能不返回新的refresh token，此时沿用原来的
+  if (data["refresh_token"].is_string())
+  {
+    item->refreshToken = data["refresh_token"];
+  }
+  else
+  {
+    item->refreshToken = current_credential()->refreshToken;
+  }
+
+  // 整体替换当前token，进行中的请求继续使用已取得的副本
+  {
+    lock_guard<mutex> guard(credentialMutex);
+    credential = item;
+  }
+  tokenRefreshes++;
+  if (!cfg.tokenFile.empty())
+  {
+    save_token_state(*item);
+  }
+  // 后台刷新线程按新token重新计算刷新时间
+  refreshWake.notify_all();
+  return true;
+}
+
+// token请求参数
+Params tokenParams()
+{
+  return Params{
+      {"grant_type", "password"},
+      {"username", cfg.username},
+      {"password", cfg.password},
+  };
+}
+
+// 使用refresh token换取token的请求参数
+Params refreshParams(const string &refreshToken)
+{
+  return Params{
+      {"grant_type", "refresh_token"},
+      {"refresh_token", refreshToken},
+  };
+}
+
+// 同一时间只进行一次token请求
+mutex tokenMutex;
+
+// 请求token，调用前持有tokenMutex
+bool request_token()
+{
+  // 创建HTTP客户端
+  Client cli(url);
+  set_client_timeouts(cli);
+
+  // 配置basic auth
+  cli.set_basic_auth(cfg.clientId, cfg.secret);
+
+  // 发送HTTP请求，停止时可被中断
+  FetchScope scope(cli);
+
+  // 有refresh token时先换取，失败后使用密码授权
+  string refreshToken = current_credential()->refreshToken;
+  if (!refreshToken.empty())
+  {
+    Result res = upstream_call([&]()
+                               { return cli.Post("/oauth/token", refreshParams(refreshToken)); });
+    if (res && res->status == 200 && res->body.size() && apply_token(res->body))
+    {
+      return true;
+    }
+    OPC_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "refresh token换取失败，使用密码授权");
+  }
+  Result res = upstream_call([&]()
+                             { return cli.Post("/oauth/token", tokenParams()); });
+
+  // 检查请求状态和结果大小，请求失败、上游返回错误或为空则输出错误
+  if (res && res->status < 300 && res->body.size())
+  {
+    return apply_token(res->body);
+  }
+  else
+  {
+    OPC_LOG_ERROR(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "获取token失败");
+    OPC_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "%s", to_string(res.error()).c_str());
+    return false;
+  }
+}
+
+// 获取token
+bool get_token()
+{
+  lock_guard<mutex> guard(tokenMutex);
+  return request_token();
+}
+
+// 没有可用token时同步获取，只在启动时或后台刷新失败后发生
+bool ensure_token()
+{
+  if (credential_valid(*current_credential()))
+  {
+    return true;
+  }
+  lock_guard<mutex> guard(tokenMutex);
+  // 等待期间其他线程可能已经获取到token
+  if (credential_valid(*current_credential()))
+  {
+    return true;
+  }
+  return request_token();
+}
+
+// token被上游拒绝后重新获取，其他线程已换过token时直接使用新token，返回是否有可用的新token
+bool renew_rejected_token(const string &rejected)
+{
+  lock_guard<mutex> guard(tokenMutex);
+  if (current_credential()->accessToken != rejected)
+  {
+    return true;
+  }
+  OPC_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "token被拒绝，重新获取token");
+  return request_token();
+}
+
+// 下次后台刷新的时间，在有效期的tokenRefreshFraction处加减tokenRefreshJitter比例的随机抖动，
+// 多个实例不会在同一时刻刷新
+chrono::system_clock::time_point next_refresh_time(const Credential &item)
+{
+  static mt19937 rng(random_device{}());
+  double lifetime = (double)(item.expireTs - item.issuedTs);
+  uniform_real_distribution<double> jitter(-cfg.tokenRefreshJitter, cfg.tokenRefreshJitter);
+  double fraction = min(max(cfg.tokenRefreshFraction + jitter(rng), 0.0), 1.0);
+  return chrono::system_clock::from_time_t(item.issuedTs) + chrono::milliseconds((long long)(lifetime * fraction * 1000));
+}
+
+// 后台刷新线程，在token失效前获取新token，拉取流程在稳定状态下不等待token请求
+// 获取失败时按5秒起翻倍、最长60秒的间隔重试，有效期很短时两次刷新至少间隔1秒
+void refreshLoop()
+{
+  int retrySec = 5;
+  chrono::system_clock::time_point lastRefresh;
+  unique_lock<mutex> lock(refreshMutex);
+  while (!refreshStop)
+  {
+    shared_ptr<const Credential> item = current_credential();
+    chrono::system_clock::time_point due = lastRefresh + chrono::seconds(1);
+    if (credential_valid(*item))
+    {
+      due = max(due, next_refresh_time(*item));
+    }
+    if (refreshWake.wait_until(lock, due, [&item]
+                               { return refreshStop || current_credential() != item; }))
+    {
+      // 停止，或token已被其他线程替换，按新token重新计算刷新时间
+      continue;
+    }
+    lock.unlock();
+    bool ok = get_token();
+    lastRefresh = chrono::system_clock::now();
+    lock.lock();
+    if (ok)
+    {
+      retrySec = 5;
+      OPC_LOG_INFO(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "后台刷新token|失效时间: %lld",
+                  (long long)current_credential()->expireTs);
+      continue;
+    }
+    refreshWake.wait_for(lock, chrono::seconds(retrySec), []
+                         { return refreshStop; });
+    retrySec = min(retrySec * 2, 60);
+  }
+}
+
+// 停止后台刷新线程
+void stopRefresh(thread &refresher)
+{
+  {
+    lock_guard<mutex> lock(refreshMutex);
+    refreshStop = true;
+  }
+  refreshWake.notify_all();
+  if (refresher.joinable())
+  {
+    refresher.join();
+  }
+}
+
+// 解码线程池，未配置解码线程时为空
+unique_ptr<WorkStealingPool> decodePool;
+
+// 声明启动时间和地址空间是否已填充
+UA_DateTime bootTime = 0;
+bool populated = false;
+
+// 是否已获取到第一页数据
+atomic<bool> firstData{false};
+
+// 本周期已应用的页数和按设备总数应有的页数，只在拉取线程读写
+int cyclePages = 0;
+int cycleExpectedPages = 0;
+
+// 解析一页设备列表数据并应用到注册表，返回是否还需要获取下一页
+// rowCount不为空时写入上游返回的设备总数，解析失败时不写入
+bool apply_device_page(const string &body, int page, int size, int *rowCount = nullptr)
+{
+  // 解析请求结果，解析和解码的耗时计入页解析指标
+  auto start = chrono::steady_clock::now();
+  json data = json::parse(body, nullptr, false);
+  if (data.is_discarded() || !data.is_object())
+  {
+    OPC_LOG_ERROR(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "解析json数据失败");
+    OPC_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "%s", body.c_str());
+    return false;
+  }
+  // 检查返回参数flag
+  if (data["flag"] == nullptr)
+  {
+    OPC_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "未获取到flag参数");
+    OPC_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "%s", body.c_str());
+    return false;
+  }
+  // 赋值并检查返回标示
+  string flag = data["flag"];
+  if (flag != "00")
+  {
+    OPC_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "获取设备列表数据失败");
+    OPC_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "%s", to_string(data["msg"]).c_str());
+    return false;
+  }
+  // 检查返回参数rowCount
+  if (data["rowCount"] == nullptr)
+  {
+    OPC_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "未获取到rowCount参数");
+    OPC_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "%s", body.c_str());
+    return false;
+  }
+  // 检查返回参数dataList
+  if (data["dataList"] == nullptr)
+  {
+    OPC_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "未获取到dataList参数");
+    OPC_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "%s", body.c_str());
+    return false;
+  }
+  // 检查返回参数dataList是否为数组
+  if (!data["dataList"].is_array())
+  {
+    OPC_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "dataList不是有效的数组类型");
+    OPC_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "%s", to_string(data["dataList"]).c_str());
+    return false;
+  }
+  int total = data["rowCount"];
+  if (rowCount != nullptr)
+  {
+    *rowCount = total;
+  }
+  // 输出启动到获取第一页数据的耗时，包括token请求
+  if (!firstData.exchange(true))
+  {
+    OPC_LOG_INFO(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "首次数据|启动到获取第一页数据耗时: %lldms",
+                (long long)((UA_DateTime_nowMonotonic() - bootTime) / UA_DATETIME_MSEC));
+  }
+  // 按设备解码、校验和过滤dataList数组，配置了解码线程时由线程池并行执行
+  json &dataList = data["dataList"];
+  vector<DecodedDevice> decoded(dataList.size());
+  function<void(size_t)> decode = [&dataList, &decoded](size_t i)
+  {
+    decodeDeviceData(dataList[i], decoded[i]);
+  };
+  if (decodePool)
+  {
+    decodePool->forEach(decoded.size(), decode);
+  }
+  else
+  {
+    for (size_t i = 0; i < decoded.size(); i++)
+    {
+      decode(i);
+    }
+  }
+  metrics.observe(metric.pageParseSeconds, seconds_since(start));
+  // 按顺序应用设备数据
+  for (DecodedDevice &device : decoded)
+  {
+    applyDeviceData(device);
+  }
+  // 发布本页应用后的设备数和传感器数
+  registryStats.publish(next_registry_stats());
+  cyclePages++;
+  cycleExpectedPages = max(1, (total + size - 1) / size);
+
+  // 判断当前页数据是否已经达到指定大小，并且总数据量大于当前页数
+  // 如果满足条件，则说明还需要获取下一页数据
+  return dataList.size() == size && page * size < total;
+}
+
+// 生成设备列表请求的POST数据
+string devicePageBody(int page, int size, int userId)
+{
+  json jsonData = {
+      {"userId", userId},
+      {"currPage", page},
+      {"pageSize", size},
+  };
+  return jsonData.dump();
+}
+
+// 获取一页设备列表数据，返回是否还需要获取下一页
+bool get_device_page(Client &cli, int page, int size)
+{
+  // 创建header数据
+  Headers header = {
+      {"tlinkAppId", cfg.clientId},
+  };
+
+  // 设定内容类型
+  string contentType = "application/json";
+
+  // 每页取当前token，后台刷新后的下一页即使用新token
+  shared_ptr<const Credential> item = current_credential();
+  cli.set_bearer_token_auth(item->accessToken);
+
+  // 发送HTTP请求，传输错误和服务端错误按退避重试
+  auto send = [&]()
+  {
+    return cli.Post("/api/device/getDeviceSensorDatas", header, devicePageBody(page, size, item->userId), contentType);
+  };
+  auto start = chrono::steady_clock::now();
+  Result res = upstream_call(send);
+
+  // token被拒绝时重新获取token后重试一次
+  if (res && res->status == 401 && renew_rejected_token(item->accessToken))
+  {
+    item = current_credential();
+    cli.set_bearer_token_auth(item->accessToken);
+    res = upstream_call(send);
+  }
+  metrics.observe(metric.pageFetchSeconds, seconds_since(start));
+
+  // 检查请求状态和结果大小，请求失败、上游返回错误或为空则输出错误
+  if (res && res->status < 300 && res->body.size())
+  {
+    diagnostics.applyQueue.fetch_add(1, memory_order_relaxed);
+    bool more = apply_device_page(res->body, page, size);
+    diagnostics.applyQueue.fetch_sub(1, memory_order_relaxed);
+    return more;
+  }
+  else
+  {
+    OPC_LOG_ERROR(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "获取设备列表数据失败");
+    OPC_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "%s", to_string(res.error()).c_str());
+    return false;
+  }
+}
+
+// 获取设备列表数据，从指定页开始逐页获取，各页共用一个保持连接的客户端
+void get_device_datas(int page, int size)
+{
+  if (stopRequested)
+  {
+    return;
+  }
+  // token由后台刷新线程提前更新，没有可用token时才同步获取，获取失败则返回
+  if (!ensure_token())
+  {
+    return;
+  }
+
+  // 创建HTTP客户端
+  Client cli(url);
+  cli.set_keep_alive(true);
+  set_client_timeouts(cli);
+
+  // 收到停止信号后不再获取下一页，进行中的请求由监视线程中断
+  FetchScope scope(cli);
+  while (!stopRequested && get_device_page(cli, page, size))
+  {
+    page++;
+  }
+}
+
+// 声明最近一次快照中的传感器数量和写入耗时
+size_t snapshotSensors = 0;
+long long snapshotMs = 0;
+
+// 写入快照并清空已合并的变更日志
+bool compact_snapshot()
+{
+  UA_DateTime start = UA_DateTime_nowMonotonic();
+  size_t journalBytes = journal.size();
+  if (!journal.sync() || !save_snapshot())
+  {
+    return false;
+  }
+  registryDirty = false;
+  snapshotSensors = registry.sensors.size();
+  if (journal.isOpen() && !journal.truncate())
+  {
+    OPC_LOG_ERROR(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "清空变更日志失败: %s", cfg.journalFile.c_str());
+  }
+  snapshotMs = (UA_DateTime_nowMonotonic() - start) / UA_DATETIME_MSEC;
+  OPC_LOG_INFO(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "写入快照|合并日志: %zu字节, 耗时: %lldms",
+              journalBytes, snapshotMs);
+  return true;
+}
+
+// 声明本周期开始的单调时间和CPU时间
+UA_DateTime cycleStart = 0;
+long long cycleCpuStart = 0;
+
+// 拉取周期开始，重置本周期写入计数
+void begin_cycle()
+{
+  writesApplied = 0;
+  writesSuppressed = 0;
+  cyclePages = 0;
+  cycleExpectedPages = 0;
+  cycleStart = UA_DateTime_nowMonotonic();
+  cycleCpuStart = processCpuTime();
+}
+
+// 按熔断器状态更新传感器变量的对外状态，熔断器未关闭时标记为不确定，关闭后恢复
+void sync_upstream_quality()
+{
+  bool stale = upstreamBreaker.state() != CircuitBreaker::CLOSED;
+  if (stale == upstreamStale)
+  {
+    return;
+  }
+  upstreamStale = stale;
+  size_t marked = 0;
+  for (Sensor &sensor : registry.sensors)
+  {
+    if (sensor.materialized && sensor.status == UA_STATUSCODE_GOOD)
+    {
+      ValueVariant variant(&sensor);
+      updateVariable(sensor.sensorId, publishedStatus(&sensor), sourceTime(&sensor), variant.variant);
+      marked++;
+    }
+  }
+  if (stale)
+  {
+    OPC_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "上游熔断|传感器标记为不确定: %zu", marked);
+  }
+  else
+  {
+    OPC_LOG_INFO(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "上游恢复|传感器恢复为正常: %zu", marked);
+  }
+}
+
+// 拉取周期结束，输出统计、发布注册表统计并写入快照
+void end_cycle()
+{
+  // 输出上游熔断器状态和累计的重试、失败次数，并按熔断器状态更新传感器变量的对外状态
+  OPC_LOG_INFO(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "上游状态|熔断器: %s, 重试: %zu, 失败: %zu, 熔断: %zu, 拒绝: %zu",
+              CircuitBreaker::name(upstreamBreaker.state()), upstreamRetries.load(), upstreamFailures.load(),
+              upstreamBreaker.opens(), upstreamBreaker.rejected());
+  sync_upstream_quality();
+
+  // 更新运行指标
+  metrics.observe(metric.cycleSeconds, (UA_DateTime_nowMonotonic() - cycleStart) / (double)UA_DATETIME_SEC);
+  metrics.add(metric.writesApplied, writesApplied);
+  metrics.add(metric.writesSuppressed, writesSuppressed);
+  metrics.set(metric.cycleWritesApplied, (double)writesApplied);
+  metrics.set(metric.cycleWritesSuppressed, (double)writesSuppressed);
+
+  // 发布诊断变量和运行指标读取的注册表统计
+  RegistryStats *stats = next_registry_stats();
+  stats->lastCycleMs = (UA_DateTime_nowMonotonic() - cycleStart) / (double)UA_DATETIME_MSEC;
+  stats->cyclePages = (uint32_t)cyclePages;
+  stats->writesSuppressed += writesSuppressed;
+  if (cyclePages > 0 && cyclePages >= cycleExpectedPages)
+  {
+    stats->lastSuccessfulPoll = UA_DateTime_now();
+  }
+  registryStats.publish(stats);
+
+  // 输出写入统计和本周期耗时、CPU时间、常驻内存
+  OPC_LOG_INFO(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "写入统计|写入: %zu, 抑制: %zu",
+              writesApplied, writesSuppressed);
+  OPC_LOG_INFO(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "拉取周期|传感器: %zu, 耗时: %lldms, CPU: %lldms, 内存: %zuKB",
+              registry.sensors.size(), (long long)((UA_DateTime_nowMonotonic() - cycleStart) / UA_DATETIME_MSEC),
+              processCpuTime() - cycleCpuStart, residentMemory() / 1024);
+
+  // 首次拉取完成时输出启动到地址空间填充完成的耗时
+  if (!populated && !registry.devices.empty())
+  {
+    populated = true;
+    OPC_LOG_INFO(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "冷启动|首次拉取完成, 耗时: %lldms",
+                (long long)((UA_DateTime_nowMonotonic() - bootTime) / UA_DATETIME_MSEC));
+  }
+
+  // 本周期的变更日志组提交一次，写入和落盘在日志的写线程中完成，不阻塞服务器线程
+  if (!journal.commit())
+  {
+    OPC_LOG_ERROR(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "写入变更日志失败");
+  }
+
+  // 写入快照，使用变更日志时只在日志过大或有新增传感器时合并，停止时由退出流程按剩余时间决定
+  if (!cfg.snapshotFile.empty() && registryDirty && !stopRequested &&
+      (!journal.isOpen() || journal.size() >= cfg.journalCompactBytes || registry.sensors.size() != snapshotSensors))
+  {
+    compact_snapshot();
+  }
+
+  // 输出常驻节点统计
+  logNodeStats();
+}
+
+// API请求回调函数
+void httpCallback(UA_Server *server, void *data)
+{
+  begin_cycle();
+
+  // 拉取数据时写入的节点不计入客户端访问
+  lazyBypass = true;
+  // 获取设备列表数据
+  get_device_datas(1, 100);
+  lazyBypass = false;
+
+  end_cycle();
+}
+
+// 时间转换函数
+UA_DateTime convertToDateTime(UA_UInt64 expectedTime)
+{
+  UA_UInt64 interval = (UA_UInt64)(expectedTime * UA_DATETIME_MSEC);
+  UA_DateTime nextTime = UA_DateTime_nowMonotonic() + (UA_DateTime)interval;
+
+  return nextTime;
+}
+
+// 声明诊断空间索引
+UA_UInt16 diagnosticsNsIndex;
+
+// 诊断变量，节点ID为诊断空间中的序号加2，诊断对象的节点ID为1
+enum DiagnosticItem
+{
+  DIAG_LAST_CYCLE_MS,
+  DIAG_LAST_SUCCESSFUL_POLL,
+  DIAG_CYCLE_PAGES,
+  DIAG_UPSTREAM_ERRORS,
+  DIAG_TOKEN_EXPIRY,
+  DIAG_DEVICES,
+  DIAG_SENSORS,
+  DIAG_APPLY_QUEUE,
+  DIAG_WRITES_SUPPRESSED,
+  DIAG_ITEMS,
+};
+
+// 诊断变量的浏览名称、说明和数据类型
+struct DiagnosticVariable
+{
+  const char *name;
+  const char *desc;
+  int type;
+};
+
+const DiagnosticVariable diagnosticVariables[DIAG_ITEMS] = {
+    {"LastCycleDurationMs", "上一拉取周期的耗时毫秒数", UA_TYPES_DOUBLE},
+    {"LastSuccessfulPollTime", "最近一次全部页面拉取成功的时间", UA_TYPES_DATETIME},
+    {"PagesPerCycle", "上一拉取周期应用的设备页数", UA_TYPES_UINT32},
+    {"UpstreamErrorCount", "累计的上游请求错误数，每次重试单独计数", UA_TYPES_UINT64},
+    {"TokenExpiry", "当前token的失效时间", UA_TYPES_DATETIME},
+    {"KnownDevices", "已知设备数", UA_TYPES_UINT32},
+    {"KnownSensors", "已知传感器数", UA_TYPES_UINT32},
+    {"ApplyQueueDepth", "已获取尚未应用完成的设备页数", UA_TYPES_UINT32},
+    {"SuppressedWrites", "累计的抑制写入数", UA_TYPES_UINT64},
+};
+
+// 读取诊断变量，节点上下文为诊断变量序号
+UA_StatusCode readDiagnostic(UA_Server *, const UA_NodeId *, void *, const UA_NodeId *, void *nodeContext,
+                             UA_Boolean includeSourceTimeStamp, const UA_NumericRange *, UA_DataValue *value)
+{
+  size_t item = (size_t)(uintptr_t)nodeContext;
+  if (item >= DIAG_ITEMS)
+  {
+    return UA_STATUSCODE_BADINTERNALERROR;
+  }
+  // 固定当前的注册表统计，纪元槽用尽时无法读取，尚未发布时各项为0
+  Rcu<RegistryStats>::Reader &reader = registry_stats_reader();
+  if (!reader.valid())
+  {
+    return UA_STATUSCODE_BADRESOURCEUNAVAILABLE;
+  }
+  Rcu<RegistryStats>::Guard pinned(reader);
+  const RegistryStats stats = pinned.get() != nullptr ? *pinned.get() : RegistryStats();
+  UA_Double number = 0;
+  UA_DateTime time = 0;
+  UA_UInt32 count = 0;
+  UA_UInt64 total = 0;
+  switch (item)
+  {
+  case DIAG_LAST_CYCLE_MS:
+    number = stats.lastCycleMs;
+    break;
+  case DIAG_LAST_SUCCESSFUL_POLL:
+    time = stats.lastSuccessfulPoll;
+    break;
+  case DIAG_CYCLE_PAGES:
+    count = stats.cyclePages;
+    break;
+  case DIAG_UPSTREAM_ERRORS:
+    total = diagnostics.upstreamErrors.load(memory_order_relaxed);
+    break;
+  case DIAG_TOKEN_EXPIRY:
+  {
+    time_t expireTs = current_credential()->expireTs;
+    time = expireTs > 0 ? (UA_DateTime)expireTs * UA_DATETIME_SEC + UA_DATETIME_UNIX_EPOCH : 0;
+    break;
+  }
+  case DIAG_DEVICES:
+    count = stats.devices;
+    break;
+  case DIAG_SENSORS:
+    count = stats.sensors;
+    break;
+  case DIAG_APPLY_QUEUE:
+    count = diagnostics.applyQueue.load(memory_order_relaxed);
+    break;
+  case DIAG_WRITES_SUPPRESSED:
+    total = stats.writesSuppressed;
+    break;
+  }
+  int type = diagnosticVariables[item].type;
+  const void *data = type == UA_TYPES_DOUBLE     ? (const void *)&number
+                     : type == UA_TYPES_DATETIME ? (const void *)&time
+                     : type == UA_TYPES_UINT32   ? (const void *)&count
+                                                 : (const void *)&total;
+  UA_StatusCode retval = UA_Variant_setScalarCopy(&value->value, data, &UA_TYPES[type]);
+  if (retval != UA_STATUSCODE_GOOD)
+  {
+    return retval;
+  }
+  value->hasValue = true;
+  if (includeSourceTimeStamp)
+  {
+    value->sourceTimestamp = UA_DateTime_now();
+    value->hasSourceTimestamp = true;
+  }
+  return UA_STATUSCODE_GOOD;
+}
+
+// 在独立的命名空间中创建诊断对象和诊断变量，变量为只读的数据源变量
+UA_StatusCode createDiagnosticsObject()
+{
+  diagnosticsNsIndex = UA_Server_addNamespace(opcServer, (const char *)"diagnostics");
+  UA_ObjectAttributes oAttr = UA_ObjectAttributes_default;
+  oAttr.description = UA_LOCALIZEDTEXT((char *)"zh-CN", (char *)"服务器自诊断");
+  oAttr.displayName = UA_LOCALIZEDTEXT((char *)"zh-CN", (char *)"Diagnostics");
+  UA_StatusCode retval = UA_Server_addObjectNode(
+      opcServer,                                                   // server
+      UA_NODEID_NUMERIC(diagnosticsNsIndex, 1),                    // requestedNewNodeId
+      UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),                // parentNodeId
+      UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),                    // referenceTypeId
+      UA_QUALIFIEDNAME(diagnosticsNsIndex, (char *)"Diagnostics"), // browseName
+      UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE),               // typeDefinition
+      oAttr,                                                       // objectAttributes
+      NULL, NULL);
+
+  UA_DataSource dataSource;
+  dataSource.read = readDiagnostic;
+  dataSource.write = NULL;
+  for (size_t item = 0; item < DIAG_ITEMS && retval == UA_STATUSCODE_GOOD; item++)
+  {
+    const DiagnosticVariable &variable = diagnosticVariables[item];
+    UA_VariableAttributes vAttr = UA_VariableAttributes_default;
+    vAttr.description = UA_LOCALIZEDTEXT((char *)"zh-CN", (char *)variable.desc);
+    vAttr.displayName = UA_LOCALIZEDTEXT((char *)"zh-CN", (char *)variable.name);
+    vAttr.accessLevel = UA_ACCESSLEVELMASK_READ;
+    vAttr.valueRank = UA_VALUERANK_SCALAR;
+    vAttr.dataType = UA_TYPES[variable.type].typeId;
+    retval = UA_Server_addDataSourceVariableNode(
+        opcServer,                                                   // server
+        UA_NODEID_NUMERIC(diagnosticsNsIndex, (UA_UInt32)item + 2),  // requestedNewNodeId
+        UA_NODEID_NUMERIC(diagnosticsNsIndex, 1),                    // parentNodeId
+        UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT),                 // referenceTypeId
+        UA_QUALIFIEDNAME(diagnosticsNsIndex, (char *)variable.name), // browseName
+        UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE),         // typeDefinition
+        vAttr,                                                       // variableAttributes
+        dataSource, (void *)(uintptr_t)item, NULL);
+  }
+  OPC_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "%s|创建OPC诊断对象", UA_StatusCode_name(retval));
+
+  return retval;
+}
+
+// 声明并初始化运行状态
+UA_Boolean running = true;
+
+// 信号处理函数
+void signalHandler(int sig)
+{
+  // 记录收到停止信号的时间，重复的信号不更新
+  if (!stopRequested.exchange(true))
+  {
+    stopRequestedAt = UA_DateTime_nowMonotonic();
+  }
+  // 运行状态为false
+  running = false;
+}
+
+// 停止监视线程，收到停止信号后反复中断阻塞请求，超过停止期限仍未退出时强制退出
+mutex watcherMutex;
+condition_variable watcherWake;
+bool watcherStop = false;
+
+void watchShutdown()
+{
+  unique_lock<mutex> lock(watcherMutex);
+  while (!watcherStop)
+  {
+    // 未收到停止信号时低频检查，收到后每20毫秒中断一次，覆盖中断后才发起的请求
+    watcherWake.wait_for(lock, chrono::milliseconds(stopRequested ? 20 : 100));
+    if (!stopRequested || watcherStop)
+    {
+      continue;
+    }
+    cancel_fetch();
+    if (shutdown_remaining_ms() <= 0)
+    {
+      OPC_LOG_FATAL(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "停止超时|超过%dms仍未退出，强制退出", cfg.shutdownTimeoutMs);
+      asyncLog.flush(200);
+      _exit(EXIT_FAILURE);
+    }
+  }
+}
+
+// 结束停止监视线程
+void stopWatcher(thread &watcher)
+{
+  {
+    lock_guard<mutex> lock(watcherMutex);
+    watcherStop = true;
+  }
+  watcherWake.notify_all();
+  if (watcher.joinable())
+  {
+    watcher.join();
+  }
+}
+
+// 按角色设置当前线程的CPU集合和优先级，并记录实际生效的线程拓扑
+void bind_thread_role(const char *role)
+{
+  auto iter = cfg.threadRoles.find(role);
+  string error;
+  if (iter != cfg.threadRoles.end() && !applyThreadRole(iter->second, error))
+  {
+    OPC_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "线程拓扑|%s设置失败: %s", role, error.c_str());
+  }
+  OPC_LOG_INFO(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "线程拓扑|%s: %s", role, describeThread().c_str());
+}
+
+// 声明并初始化文件夹名称
+string folderName = "拓普瑞";
+
+#if UA_MULTITHREADING >= 100
+// 多线程模式下拉取和应用数据在独立线程执行，不阻塞网络循环
+mutex ingestMutex;
+condition_variable ingestWake;
+bool ingestStop = false;
+
+// 拉取线程，启动1000毫秒后首次拉取，之后每10000毫秒拉取一次
+void ingestLoop()
+{
+  bind_thread_role("ingest");
+  auto next = chrono::steady_clock::now() + chrono::milliseconds(1000);
+  unique_lock<mutex> lock(ingestMutex);
+  while (!ingestWake.wait_until(lock, next, []
+                                { return ingestStop; }))
+  {
+    lock.unlock();
+    httpCallback(opcServer, NULL);
+    lock.lock();
+    next = max(next + chrono::milliseconds(10000), chrono::steady_clock::now());
+  }
+}
+
+// 停止拉取线程并等待当前周期结束
+void stopIngest(thread &ingest)
+{
+  {
+    lock_guard<mutex> lock(ingestMutex);
+    ingestStop = true;
+  }
+  ingestWake.notify_all();
+  if (ingest.joinable())
+  {
+    ingest.join();
+  }
+}
+#endif
+
+#if OPC_EVENT_LOOP
+// 事件循环模式，网络循环和上游HTTP请求在同一个epoll循环中驱动，HTTP等待不阻塞服务器
+// 拉取流程为协程，等待响应时挂起，多页请求同时进行
+int loopEpoll = -1;
+AsyncHttp asyncHttp;
+Executor executor;
+// 本周期是否还有请求未完成
+bool cycleInFlight = false;
+
+// 异常的说明文字
+string exception_text(exception_ptr error)
+{
+  try
+  {
+    rethrow_exception(error);
+  }
+  catch (const exception &e)
+  {
+    return e.what();
+  }
+  catch (...)
+  {
+    return "未知异常";
+  }
+}
+
+// 分离协程中未捕获的异常，记录后丢弃，事件循环继续运行
+void log_task_error(exception_ptr error)
+{
+  OPC_LOG_ERROR(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "协程异常: %s", exception_text(error).c_str());
+}
+
+// 等待上游HTTP响应，响应回调把协程投递回执行器，在本轮事件处理完后恢复
+struct UpstreamCall
+{
+  string method;
+  string path;
+  AsyncHttp::Headers headers;
+  string body;
+  AsyncHttp::Response response;
+
+  bool await_ready() const
+  {
+    return false;
+  }
+
+  void await_suspend(coroutine_handle<> handle)
+  {
+    asyncHttp.request(method, path, headers, body, [this, handle](const AsyncHttp::Response &res)
+                      {
+                        response = res;
+                        executor.post(handle);
+                      });
+  }
+
+  AsyncHttp::Response await_resume()
+  {
+    return move(response);
+  }
+};
+
+// 重试等待中的协程，到时由服务器定时回调投递回执行器，停止时由事件循环直接投递
+unordered_set<void *> retrySleepers;
+
+void resumeRetry(UA_Server *, void *data)
+{
+  // 停止时已被提前投递的协程不再投递
+  if (retrySleepers.erase(data) > 0)
+  {
+    executor.post(coroutine_handle<>::from_address(data));
+  }
+}
+
+// 等待指定毫秒数后重试，等待期间服务器按定时回调唤醒事件循环
+struct RetryDelay
+{
+  int ms;
+
+  bool await_ready() const
+  {
+    return ms <= 0 || !running;
+  }
+
+  void await_suspend(coroutine_handle<> handle)
+  {
+    retrySleepers.insert(handle.address());
+    UA_Server_addTimedCallback(opcServer, resumeRetry, handle.address(), convertToDateTime(ms), NULL);
+  }
+
+  void await_resume() const
+  {
+  }
+};
+
+// 带重试和熔断的异步上游请求，与upstream_call的规则相同
+Task<AsyncHttp::Response> async_upstream(string method, string path, AsyncHttp::Headers headers, string body)
+{
+  if (!upstreamBreaker.allow())
+  {
+    OPC_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "上游熔断中，跳过请求");
+    AsyncHttp::Response rejected;
+    rejected.error = "circuit open";
+    co_return rejected;
+  }
+  UpstreamCall call = {method, path, headers, body, {}};
+  AsyncHttp::Response res = co_await call;
+  record_upstream_attempt(res.status, res.body.size());
+  for (int attempt = 0; attempt < cfg.retryMax && running && retryable_status(res.status); attempt++)
+  {
+    upstreamRetries++;
+    RetryDelay delay = {retry_delay_ms(attempt)};
+    co_await delay;
+    if (!running)
+    {
+      break;
+    }
+    UpstreamCall retry = {method, path, headers, body, {}};
+    res = co_await retry;
+    record_upstream_attempt(res.status, res.body.size());
+  }
+  record_upstream_result(res.status);
+  co_return res;
+}
+
+// 异步请求token
+Task<AsyncHttp::Response> async_token_request(Params params)
+{
+  AsyncHttp::Headers headers = {
+      make_basic_authentication_header(cfg.clientId, cfg.secret),
+      {"Content-Type", "application/x-www-form-urlencoded"},
+  };
+  co_return co_await async_upstream("POST", "/oauth/token", headers, httplib::detail::params_to_query_str(params));
+}
+
+// 异步请求token，调用前持有tokenMutex，有refresh token时先换取，失败后使用密码授权
+Task<bool> async_request_token()
+{
+  string refreshToken = current_credential()->refreshToken;
+  if (!refreshToken.empty())
+  {
+    AsyncHttp::Response res = co_await async_token_request(refreshParams(refreshToken));
+    if (res.status == 200 && !res.body.empty() && apply_token(res.body))
+    {
+      co_return true;
+    }
+    OPC_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "refresh token换取失败，使用密码授权");
+  }
+  AsyncHttp::Response res = co_await async_token_request(tokenParams());
+  if (res.status == 0 || res.status >= 300 || res.body.empty())
+  {
+    OPC_LOG_ERROR(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "获取token失败");
+    OPC_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "%s", res.error.c_str());
+    co_return false;
+  }
+  co_return apply_token(res.body);
+}
+
+// 事件循环中同一时间只有一个协程获取token，其余协程等待其结果
+bool tokenRenewing = false;
+bool tokenRenewed = false;
+vector<coroutine_handle<>> tokenWaiters;
+
+// 等待进行中的token获取完成，返回其结果
+struct TokenWait
+{
+  bool await_ready() const
+  {
+    return !tokenRenewing;
+  }
+
+  void await_suspend(coroutine_handle<> handle)
+  {
+    tokenWaiters.push_back(handle);
+  }
+
+  bool await_resume() const
+  {
+    return tokenRenewed;
+  }
+};
+
+// 异步获取token，rejected为被上游拒绝的token，为空时表示当前没有可用token，返回是否有可用的新token
+// 与后台刷新线程共用tokenMutex，同一个refresh token不会被使用两次；锁由刷新线程持有时间隔重试加锁，
+// 事件循环不阻塞；加锁后其他线程已换过token时直接使用新token
+Task<bool> async_get_token(string rejected)
+{
+  if (tokenRenewing)
+  {
+    co_return co_await TokenWait{};
+  }
+  if (!rejected.empty() && current_credential()->accessToken != rejected)
+  {
+    co_return true;
+  }
+  tokenRenewing = true;
+  bool locked = false;
+  while (running && !(locked = tokenMutex.try_lock()))
+  {
+    RetryDelay delay = {20};
+    co_await delay;
+  }
+  bool ok = false;
+  if (locked)
+  {
+    shared_ptr<const Credential> item = current_credential();
+    if (rejected.empty() ? credential_valid(*item) : item->accessToken != rejected)
+    {
+      ok = true;
+    }
+    else
+    {
+      if (!rejected.empty())
+      {
+        OPC_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "token被拒绝，重新获取token");
+      }
+      try
+      {
+        ok = co_await async_request_token();
+      }
+      catch (...)
+      {
+        OPC_LOG_ERROR(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "获取token异常: %s", exception_text(current_exception()).c_str());
+      }
+    }
+    tokenMutex.unlock();
+  }
+  // 唤醒等待的协程，它们按新token重试
+  tokenRenewing = false;
+  tokenRenewed = ok;
+  for (coroutine_handle<> handle : tokenWaiters)
+  {
+    executor.post(handle);
+  }
+  tokenWaiters.clear();
+  co_return ok;
+}
+
+// 异步请求一页设备列表数据
+Task<AsyncHttp::Response> async_page_request(int page, int size, const Credential &item)
+{
+  AsyncHttp::Headers headers = {
+      {"tlinkAppId", cfg.clientId},
+      make_bearer_token_authentication_header(item.accessToken),
+      {"Content-Type", "application/json"},
+  };
+  co_return co_await async_upstream("POST", "/api/device/getDeviceSensorDatas", headers, devicePageBody(page, size, item.userId));
+}
+
+// 异步获取并应用一页设备列表数据，返回是否还需要获取下一页，rowCount同apply_device_page
+Task<bool> async_device_page(int page, int size, int *rowCount)
+{
+  shared_ptr<const Credential> item = current_credential();
+  auto start = chrono::steady_clock::now();
+  AsyncHttp::Response res = co_await async_page_request(page, size, *item);
+  // token被拒绝时重新获取token后重试一次，同时被拒绝的协程合并为一次获取
+  if (res.status == 401)
+  {
+    if (co_await async_get_token(item->accessToken))
+    {
+      item = current_credential();
+      res = co_await async_page_request(page, size, *item);
+    }
+  }
+  metrics.observe(metric.pageFetchSeconds, seconds_since(start));
+  if (res.status == 0 || res.status >= 300 || res.body.empty())
+  {
+    OPC_LOG_ERROR(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "获取设备列表数据失败");
+    OPC_LOG_DEBUG(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "%s", res.error.c_str());
+    co_return false;
+  }
+  // 解析和应用排到就绪队列末尾，先恢复同一轮到达的其他响应，让它们的下一个请求尽早发出
+  diagnostics.applyQueue.fetch_add(1, memory_order_relaxed);
+  co_await executor.schedule();
+  lazyBypass = true;
+  bool more = apply_device_page(res.body, page, size, rowCount);
+  lazyBypass = false;
+  diagnostics.applyQueue.fetch_sub(1, memory_order_relaxed);
+  co_return more;
+}
+
+// 待获取的页，各获取协程共享
+struct PageCursor
+{
+  int next;
+  int last;
+  int size;
+  bool failed;
+};
+
+// 获取协程，依次领取下一页直到全部获取、出错或停止
+Task<void> page_worker(PageCursor &cursor, WaitGroup &workers)
+{
+  try
+  {
+    while (running && !cursor.failed && cursor.next <= cursor.last)
+    {
+      int page = cursor.next++;
+      int rowCount = -1;
+      co_await async_device_page(page, cursor.size, &rowCount);
+      if (rowCount < 0)
+      {
+        cursor.failed = true;
+      }
+    }
+  }
+  catch (...)
+  {
+    // 异常按获取失败处理，本周期不再领取新页
+    OPC_LOG_ERROR(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "获取设备列表数据异常: %s", exception_text(current_exception()).c_str());
+    cursor.failed = true;
+  }
+  workers.done();
+}
+
+// 一个拉取周期，获取token和第一页后按总数由fetchConcurrency个协程同时获取其余页
+Task<void> ingest_cycle(int size)
+{
+  begin_cycle();
+  try
+  {
+    // token由后台刷新线程提前更新，没有可用token时才在事件循环中获取
+    bool ready = credential_valid(*current_credential());
+    if (!ready)
+    {
+      ready = co_await async_get_token("");
+    }
+    int rowCount = -1;
+    if (ready && running && co_await async_device_page(1, size, &rowCount) && running)
+    {
+      PageCursor cursor = {2, (rowCount + size - 1) / size, size, false};
+      WaitGroup workers(executor);
+      int count = min(cfg.fetchConcurrency, cursor.last - 1);
+      workers.add(count);
+      for (int i = 0; i < count; i++)
+      {
+        executor.spawn(page_worker(cursor, workers));
+      }
+      co_await workers.wait();
+    }
+  }
+  catch (...)
+  {
+    // 异常结束本周期，下一周期照常开始
+    OPC_LOG_ERROR(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "拉取周期异常: %s", exception_text(current_exception()).c_str());
+  }
+  cycleInFlight = false;
+  end_cycle();
+}
+
+// 事件循环模式的API请求回调函数，只启动拉取协程，响应在事件循环中处理
+void asyncHttpCallback(UA_Server *, void *)
+{
+  // 上一周期尚未完成则跳过本次
+  if (cycleInFlight)
+  {
+    OPC_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "上一拉取周期尚未完成，跳过本次拉取");
+    return;
+  }
+  cycleInFlight = true;
+  executor.spawn(ingest_cycle(100));
+}
+
+// 运行事件循环直到停止
+// 没有上游请求时由UA_Server_run_iterate在服务器的网络等待中阻塞到下一个定时回调，
+// 有请求进行中时服务器非阻塞迭代，在epoll上等待HTTP事件，等待时间不超过loopTickMs，
+// 客户端请求的额外延迟不超过loopTickMs；每轮事件处理完后恢复就绪的拉取协程
+UA_StatusCode run_event_loop()
+{
+  loopEpoll = epoll_create1(EPOLL_CLOEXEC);
+  executor.setErrorHandler(log_task_error);
+  if (loopEpoll < 0 || !asyncHttp.init(loopEpoll, url, cfg.httpTimeoutMs, cfg.fetchConcurrency))
+  {
+    OPC_LOG_FATAL(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "初始化事件循环失败: %s", url.c_str());
+    return UA_STATUSCODE_BADINTERNALERROR;
+  }
+  UA_StatusCode retval = UA_Server_run_startup(opcServer);
+  if (retval != UA_STATUSCODE_GOOD)
+  {
+    return retval;
+  }
+  epoll_event events[64];
+  while (running)
+  {
+    bool idle = asyncHttp.inFlight() == 0 && executor.empty();
+    UA_UInt16 serverTimeout = UA_Server_run_iterate(opcServer, idle);
+    // 有就绪的协程时不等待
+    int timeout = idle || !executor.empty() ? 0 : min((int)serverTimeout, cfg.loopTickMs);
+    int expire = asyncHttp.expire();
+    if (expire >= 0 && expire < timeout)
+    {
+      timeout = expire;
+    }
+    int count = epoll_wait(loopEpoll, events, 64, timeout);
+    for (int i = 0; i < count; i++)
+    {
+      asyncHttp.handle(events[i].data.u64, events[i].events);
+    }
+    executor.run();
+  }
+  // 取消进行中的请求并唤醒等待重试的协程，等待中的协程收到错误后结束本周期
+  do
+  {
+    asyncHttp.cancelAll();
+    for (void *address : retrySleepers)
+    {
+      executor.post(coroutine_handle<>::from_address(address));
+    }
+    retrySleepers.clear();
+    executor.run();
+  } while (asyncHttp.inFlight() > 0 || !executor.empty());
+  retval = UA_Server_run_shutdown(opcServer);
+  close(loopEpoll);
+  return retval;
+}
+#endif
+
+// 在采集线程固定当前的注册表统计并读取其中一项，纪元槽用尽或尚未发布时为0
+double pinned_registry_stat(uint32_t RegistryStats::*field)
+{
+  Rcu<RegistryStats>::Guard stats(registry_stats_reader());
+  return stats.get() != nullptr ? (double)(stats.get()->*field) : 0;
+}
+
+// 定义采集时读取的运行指标，在启动其他线程之前调用
+void define_collected_metrics()
+{
+  metrics.collect("opc_devices", "已知设备数", "gauge", []
+                  { return pinned_registry_stat(&RegistryStats::devices); });
+  metrics.collect("opc_sensors", "已知传感器数", "gauge", []
+                  { return pinned_registry_stat(&RegistryStats::sensors); });
+  metrics.collect("opc_token_refreshes_total", "获取token次数", "counter", []
+                  { return (double)tokenRefreshes.load(); });
+  metrics.collect("opc_upstream_retries_total", "上游请求重试次数", "counter", []
+                  { return (double)upstreamRetries.load(); });
+  metrics.collect("opc_upstream_failures_total", "重试后仍失败的上游请求数", "counter", []
+                  { return (double)upstreamFailures.load(); });
+  metrics.collect("opc_upstream_breaker_state", "上游熔断器状态，0关闭，1打开，2半开", "gauge", []
+                  { return (double)upstreamBreaker.state(); });
+  metrics.collect("opc_upstream_breaker_opens_total", "上游熔断器打开次数", "counter", []
+                  { return (double)upstreamBreaker.opens(); });
+  metrics.collect("opc_upstream_breaker_rejected_total", "熔断器打开期间被拒绝的上游请求数", "counter", []
+                  { return (double)upstreamBreaker.rejected(); });
+  metrics.collect("opc_log_dropped_total", "异步日志缓冲区已满而丢弃的记录数", "counter", []
+                  { return (double)asyncLog.dropped(); });
+}
+
+// 运行指标HTTP服务，只使用一个工作线程
+Server metricsServer;
+
+// 在后台线程启动运行指标HTTP服务
+thread start_metrics_server()
+{
+  metricsServer.new_task_queue = []
+  { return new ThreadPool(1); };
+  metricsServer.Get("/metrics", [](const Request &, Response &res)
+                    { res.set_content(metrics.render(), "text/plain; version=0.0.4; charset=utf-8"); });
+  if (!metricsServer.bind_to_port(cfg.metricsHost, cfg.metricsPort))
+  {
+    OPC_LOG_ERROR(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "运行指标|监听%s:%d失败", cfg.metricsHost.c_str(),
+                  cfg.metricsPort);
+    return thread();
+  }
+  OPC_LOG_INFO(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "运行指标|http://%s:%d/metrics", cfg.metricsHost.c_str(),
+               cfg.metricsPort);
+  return thread([]()
+                { metricsServer.listen_after_bind(); });
+}
+
+// 停止运行指标HTTP服务
+void stop_metrics_server(thread &server)
+{
+  if (server.joinable())
+  {
+    metricsServer.stop();
+    server.join();
+  }
+}
+
+// OPC-UA服务器
+int boot_server(UA_LogLevel log_level)
+{
+  // 注册信号处理函数，用于处理SIGINT和SIGTERM信号
+  signal(SIGINT, signalHandler);
+  signal(SIGTERM, signalHandler);
+
+  // 记录启动时间
+  bootTime = UA_DateTime_nowMonotonic();
+
+  // 创建OPC-UA服务器对象
+  opcServer = UA_Server_new();
+
+  // 设置OPC-UA服务器配置
   serverCfg = UA_Server_getConfig(opcServer);
-  serverCfg->logger = UA_Log_Stdout_withLevel(log_level);
+  if (cfg.asyncLog)
+  {
+    asyncLog.start(cfg.logBufferRecords, log_level);
+    serverCfg->logger = asyncLog.logger();
+  }
+  else
+  {
+    serverCfg->logger = UA_Log_Stdout_withLevel(log_level);
+  }
+  setLogLevel(log_level);
   UA_ServerConfig_setMinimal(serverCfg, 4840, NULL);
   cout << "===服务端口: 4840===" << endl;
 
@@ -664,22 +2247,176 @@ int boot_server(UA_LogLevel log_level)
 
   // 创建设备厂家文件夹
   UA_StatusCode retval = createFolderObject(folderId, UA_NS0ID_OBJECTSFOLDER, folderName.c_str(), folderName.c_str());
-  // 只有创建文件夹成功才注册回调函数
-  if (retval == UA_STATUSCODE_GOOD)
+
+  // 创建诊断对象，失败时不影响数据拉取
+  if (createDiagnosticsObject() != UA_STATUSCODE_GOOD)
+  {
+    OPC_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "创建OPC诊断对象失败");
+  }
+#if UA_MULTITHREADING >= 100
+  // 懒加载在持有服务器锁的节点查询中创建节点，多线程模式下不支持
+  if (cfg.lazyNodes)
+  {
+    OPC_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "多线程模式不支持lazyNodes，已关闭懒加载");
+    cfg.lazyNodes = false;
+  }
+#endif
+  // 懒加载模式下接管节点查询，首次浏览或读取设备时物化传感器变量
+  if (cfg.lazyNodes)
+  {
+    nodestoreGetNode = serverCfg->nodestore.getNode;
+    serverCfg->nodestore.getNode = lazyGetNode;
+    // 定期回收空闲设备的传感器变量
+    if (cfg.lazyIdleSec > 0)
+    {
+      UA_Server_addRepeatedCallback(opcServer, evictCallback, NULL, min(cfg.lazyIdleSec, 60) * 1000.0, NULL);
+    }
+  }
+
+  // 在首次拉取数据前从快照和变更日志恢复地址空间
+  if (retval == UA_STATUSCODE_GOOD && !cfg.snapshotFile.empty() && load_snapshot())
+  {
+    snapshotSensors = registry.sensors.size();
+    if (!cfg.journalFile.empty())
+    {
+      replay_journal();
+    }
+    rebuild_address_space();
+    registryStats.publish(next_registry_stats());
+    populated = true;
+    OPC_LOG_INFO(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "暖启动|从快照恢复设备: %zu, 传感器: %zu, 耗时: %lldms",
+                registry.devices.size(), registry.sensors.size(),
+                (long long)((UA_DateTime_nowMonotonic() - bootTime) / UA_DATETIME_MSEC));
+  }
+
+  // 打开变更日志，日志中的槽位依赖快照，未配置快照时不使用
+  if (!cfg.journalFile.empty())
+  {
+    if (cfg.snapshotFile.empty())
+    {
+      OPC_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "未配置snapshotFile，变更日志不启用");
+    }
+    else if (!journal.open(cfg.journalFile.c_str()))
+    {
+      OPC_LOG_ERROR(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "打开变更日志失败: %s", cfg.journalFile.c_str());
+    }
+    else if (snapshotSensors == 0 && journal.size() > 0)
+    {
+      // 没有可用快照时旧日志的槽位已失效
+      journal.truncate();
+    }
+  }
+
+#if !OPC_EVENT_LOOP
+  if (cfg.eventLoop)
+  {
+    OPC_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "事件循环模式仅支持Linux且需以C++20编译，已关闭");
+    cfg.eventLoop = false;
+  }
+#endif
+
+  // 创建解码线程池
+  if (cfg.decodeWorkers > 0)
+  {
+    decodePool.reset(new WorkStealingPool(cfg.decodeWorkers, [](size_t)
+                                          { bind_thread_role("decode"); }));
+  }
+
+  // 定义运行指标，配置了端口时启动运行指标HTTP服务
+  define_collected_metrics();
+  thread metricsThread;
+  if (cfg.metricsPort > 0)
+  {
+    metricsThread = start_metrics_server();
+  }
+
+  // 启动停止监视线程，收到停止信号后中断阻塞请求并保证在期限内退出
+  thread watcher(watchShutdown);
+
+  // 设置上游熔断器
+  upstreamBreaker.configure(cfg.breakerFailures, cfg.breakerOpenMs);
+
+  // 从状态文件恢复token，未失效时首次拉取无需等待token请求
+  if (!cfg.tokenFile.empty())
+  {
+    load_token_state();
+  }
+
+  // 启动token后台刷新线程，没有可用token时立即获取
+  thread refresher(refreshLoop);
+
+  // 事件循环模式下拉取回调只发起请求，响应在事件循环中处理
+  UA_ServerCallback pollCallback = httpCallback;
+#if OPC_EVENT_LOOP
+  if (cfg.eventLoop)
+  {
+    pollCallback = asyncHttpCallback;
+  }
+#endif
+
+  // 只有创建文件夹成功才开始拉取数据，多线程模式下非事件循环时由拉取线程执行
+  bool ingestThread = false;
+#if UA_MULTITHREADING >= 100
+  ingestThread = !cfg.eventLoop;
+  thread ingest;
+  if (retval == UA_STATUSCODE_GOOD && ingestThread)
+  {
+    ingest = thread(ingestLoop);
+  }
+#endif
+  if (retval == UA_STATUSCODE_GOOD && !ingestThread)
   {
     // 声明回调ID
     UA_UInt64 callbackId = 0;
     // 添加周期性回调，每10000毫秒执行一次
-    UA_Server_addRepeatedCallback(opcServer, httpCallback, NULL, 10000, &callbackId);
+    UA_Server_addRepeatedCallback(opcServer, pollCallback, NULL, 10000, &callbackId);
 
     // 设定下次回调时间
     UA_DateTime nextTime = convertToDateTime(1000);
     // 添加定时回调，1000毫秒后执行
-    UA_Server_addTimedCallback(opcServer, httpCallback, NULL, nextTime, NULL);
+    UA_Server_addTimedCallback(opcServer, pollCallback, NULL, nextTime, NULL);
+  }
+  if (!ingestThread && cfg.threadRoles.count("ingest"))
+  {
+    OPC_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "拉取和写入在网络循环线程执行，ingest线程配置不生效");
   }
 
+  // 网络循环线程最后绑定，之前创建的线程不继承它的CPU集合
+  bind_thread_role("network");
+
   // 启动服务器并等待其停止
+#if OPC_EVENT_LOOP
+  retval = cfg.eventLoop ? run_event_loop() : UA_Server_run(opcServer, &running);
+#else
   retval = UA_Server_run(opcServer, &running);
+#endif
+#if UA_MULTITHREADING >= 100
+  stopIngest(ingest);
+#endif
+  stopRefresh(refresher);
+
+  // 退出前合并快照，下次启动无需回放日志
+  // 已提交的日志足以恢复，剩余时间不够写快照时只提交日志，下次启动时回放
+  if (!cfg.snapshotFile.empty() && registryDirty)
+  {
+    if (!journal.isOpen() || shutdown_remaining_ms() > snapshotMs * 2)
+    {
+      compact_snapshot();
+    }
+    else if (journal.sync())
+    {
+      OPC_LOG_WARNING(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "停止|剩余时间不足以写入快照，下次启动时回放变更日志");
+    }
+  }
+  journal.close();
+  decodePool.reset();
+  stopWatcher(watcher);
+  stop_metrics_server(metricsThread);
+  if (stopRequested)
+  {
+    OPC_LOG_INFO(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "停止|收到停止信号到退出耗时: %lldms",
+                (long long)((UA_DateTime_nowMonotonic() - stopRequestedAt) / UA_DATETIME_MSEC));
+  }
 
   // 删除服务器对象
   UA_Server_delete(opcServer);
@@ -687,17 +2424,17 @@ int boot_server(UA_LogLevel log_level)
   // 清除服务器配置
   UA_ServerConfig_clean(serverCfg);
 
-  // 释放设备列表变量
-  for (auto &item : deviceList)
-  {
-    delete item.second;
-  }
+  // 释放设备注册表
+  registry.clear();
+
+  // 写出剩余的日志，清除服务器配置时已结束的不重复处理
+  asyncLog.stop();
 
   // 返回服务器状态码
   return retval == UA_STATUSCODE_GOOD ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
-// 初始化配置
+// 初始化配置，此时服务器尚未创建，错误输出到标准输出日志器
 bool init_cfg()
 {
   // 声明json变量
@@ -709,7 +2446,7 @@ bool init_cfg()
   // 读取失败则提示并结束
   if (!file.is_open())
   {
-    UA_LOG_FATAL(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "配置文件config.json读取失败");
+    OPC_LOG_FATAL(UA_Log_Stdout, UA_LOGCATEGORY_SERVER, "配置文件config.json读取失败");
     return false;
   }
 
@@ -717,7 +2454,7 @@ bool init_cfg()
   file >> data;
   if (data["username"] == NULL)
   {
-    UA_LOG_FATAL(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "配置缺少username参数");
+    OPC_LOG_FATAL(UA_Log_Stdout, UA_LOGCATEGORY_SERVER, "配置缺少username参数");
     return false;
   }
   else
@@ -726,7 +2463,7 @@ bool init_cfg()
   }
   if (data["password"] == NULL)
   {
-    UA_LOG_FATAL(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "配置缺少password参数");
+    OPC_LOG_FATAL(UA_Log_Stdout, UA_LOGCATEGORY_SERVER, "配置缺少password参数");
     return false;
   }
   else
@@ -735,7 +2472,7 @@ bool init_cfg()
   }
   if (data["clientId"] == NULL)
   {
-    UA_LOG_FATAL(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "配置缺少clientId参数");
+    OPC_LOG_FATAL(UA_Log_Stdout, UA_LOGCATEGORY_SERVER, "配置缺少clientId参数");
     return false;
   }
   else
@@ -744,13 +2481,179 @@ bool init_cfg()
   }
   if (data["secret"] == NULL)
   {
-    UA_LOG_FATAL(&serverCfg->logger, UA_LOGCATEGORY_SERVER, "配置缺少secret参数");
+    OPC_LOG_FATAL(UA_Log_Stdout, UA_LOGCATEGORY_SERVER, "配置缺少secret参数");
     return false;
   }
   else
   {
     cfg.secret = data["secret"];
   }
+  // 可选参数：接口地址，压测时可指向本地模拟服务
+  if (data["apiUrl"] != nullptr)
+  {
+    url = data["apiUrl"];
+  }
+  // 可选参数：懒加载传感器节点
+  if (data["lazyNodes"] != nullptr)
+  {
+    cfg.lazyNodes = data["lazyNodes"];
+  }
+  if (data["lazyIdleSec"] != nullptr)
+  {
+    cfg.lazyIdleSec = data["lazyIdleSec"];
+  }
+  // 可选参数：注册表快照文件
+  if (data["snapshotFile"] != nullptr)
+  {
+    cfg.snapshotFile = data["snapshotFile"];
+  }
+  // 可选参数：变更日志文件和合并阈值
+  if (data["journalFile"] != nullptr)
+  {
+    cfg.journalFile = data["journalFile"];
+  }
+  if (data["journalCompactBytes"] != nullptr)
+  {
+    cfg.journalCompactBytes = data["journalCompactBytes"];
+  }
+  // 可选参数：多线程模式下每次让出服务器锁前写入的变量数
+  if (data["applyChunk"] != nullptr)
+  {
+    cfg.applyChunk = data["applyChunk"];
+  }
+  // 可选参数：事件循环模式
+  if (data["eventLoop"] != nullptr)
+  {
+    cfg.eventLoop = data["eventLoop"];
+  }
+  if (data["loopTickMs"] != nullptr)
+  {
+    cfg.loopTickMs = data["loopTickMs"];
+  }
+  if (data["httpTimeoutMs"] != nullptr)
+  {
+    cfg.httpTimeoutMs = data["httpTimeoutMs"];
+  }
+  if (data["fetchConcurrency"] != nullptr)
+  {
+    cfg.fetchConcurrency = max((int)data["fetchConcurrency"], 1);
+  }
+  if (data["decodeWorkers"] != nullptr)
+  {
+    cfg.decodeWorkers = max((int)data["decodeWorkers"], 0);
+  }
+  if (data["shutdownTimeoutMs"] != nullptr)
+  {
+    cfg.shutdownTimeoutMs = data["shutdownTimeoutMs"];
+  }
+  // 可选参数：token后台刷新时间和抖动，有效期的比例
+  if (data["tokenRefreshFraction"] != nullptr)
+  {
+    cfg.tokenRefreshFraction = data["tokenRefreshFraction"];
+  }
+  if (data["tokenRefreshJitter"] != nullptr)
+  {
+    cfg.tokenRefreshJitter = data["tokenRefreshJitter"];
+  }
+  // 可选参数：上游请求重试和熔断
+  if (data["retryMax"] != nullptr)
+  {
+    cfg.retryMax = max((int)data["retryMax"], 0);
+  }
+  if (data["retryBaseMs"] != nullptr)
+  {
+    cfg.retryBaseMs = max((int)data["retryBaseMs"], 0);
+  }
+  if (data["retryMaxMs"] != nullptr)
+  {
+    cfg.retryMaxMs = max((int)data["retryMaxMs"], 0);
+  }
+  if (data["breakerFailures"] != nullptr)
+  {
+    cfg.breakerFailures = max((int)data["breakerFailures"], 1);
+  }
+  if (data["breakerOpenMs"] != nullptr)
+  {
+    cfg.breakerOpenMs = max((int)data["breakerOpenMs"], 0);
+  }
+  // 可选参数：异步日志和缓冲区记录数
+  if (data["asyncLog"] != nullptr)
+  {
+    cfg.asyncLog = data["asyncLog"];
+  }
+  if (data["logBufferRecords"] != nullptr)
+  {
+    cfg.logBufferRecords = max((int)data["logBufferRecords"], 64);
+  }
+  // 可选参数：运行指标HTTP端口和监听地址
+  if (data["metricsPort"] != nullptr)
+  {
+    cfg.metricsPort = data["metricsPort"];
+  }
+  if (data["metricsHost"] != nullptr)
+  {
+    cfg.metricsHost = data["metricsHost"];
+  }
+  // 可选参数：token状态文件
+  if (data["tokenFile"] != nullptr)
+  {
+    cfg.tokenFile = data["tokenFile"];
+  }
+  // 可选参数：按线程角色配置CPU集合和优先级，如{"network": {"cpus": "0", "nice": -5}, "decode": {"cpus": "1-3"}}
+  if (data["threadRoles"] != nullptr && data["threadRoles"].is_object())
+  {
+    for (auto &item : data["threadRoles"].items())
+    {
+      ThreadRole role;
+      json value = item.value();
+      if (value["cpus"] != nullptr && !parseCpuList(value["cpus"], role.cpus))
+      {
+        OPC_LOG_FATAL(UA_Log_Stdout, UA_LOGCATEGORY_SERVER, "threadRoles.%s.cpus格式错误", item.key().c_str());
+        return false;
+      }
+      if (value["nice"] != nullptr)
+      {
+        role.setNice = true;
+        role.nice = value["nice"];
+      }
+      if (value["realtime"] != nullptr)
+      {
+        role.realtime = value["realtime"];
+      }
+      cfg.threadRoles[item.key()] = role;
+    }
+  }
+  // 可选参数：上游时间的UTC偏移分钟数
+  if (data["utcOffset"] != nullptr)
+  {
+    cfg.utcOffset = data["utcOffset"];
+  }
+  // 可选参数：按传感器类型ID配置的死区，如{"1": {"abs": 0.1, "pct": 0.5}}
+  if (data["deadband"] != nullptr && data["deadband"].is_object())
+  {
+    for (auto &item : data["deadband"].items())
+    {
+      // 键须为传感器类型ID，值须为对象，abs和pct须为数值
+      const string &key = item.key();
+      json value = item.value();
+      if (key.empty() || key.size() > 9 || key.find_first_not_of("0123456789") != string::npos || !value.is_object() ||
+          (value["abs"] != nullptr && !value["abs"].is_number()) || (value["pct"] != nullptr && !value["pct"].is_number()))
+      {
+        OPC_LOG_FATAL(UA_Log_Stdout, UA_LOGCATEGORY_SERVER, "deadband.%s格式错误", key.c_str());
+        return false;
+      }
+      Deadband deadband;
+      if (value["abs"] != nullptr)
+      {
+        deadband.abs = value["abs"];
+      }
+      if (value["pct"] != nullptr)
+      {
+        deadband.pct = value["pct"];
+      }
+      cfg.deadbands[stoi(key)] = deadband;
+    }
+  }
   return true;
 }
 